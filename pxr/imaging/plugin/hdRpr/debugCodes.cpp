@@ -21,6 +21,8 @@ PXR_NAMESPACE_OPEN_SCOPE
 TF_REGISTRY_FUNCTION(TfDebug) {
     TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_CONTEXT_CREATION, "hdRpr context creation");
     TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_CORE_UNSUPPORTED_ERROR, "hdRpr signal about unsupported errors");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_IMAGE_CACHE, "hdRpr image cache statistics");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(HD_RPR_DEBUG_MATERIAL_CACHE, "hdRpr material cache statistics");
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
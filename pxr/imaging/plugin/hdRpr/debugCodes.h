@@ -21,7 +21,9 @@ PXR_NAMESPACE_OPEN_SCOPE
 
 TF_DEBUG_CODES(
     HD_RPR_DEBUG_CONTEXT_CREATION,
-    HD_RPR_DEBUG_CORE_UNSUPPORTED_ERROR
+    HD_RPR_DEBUG_CORE_UNSUPPORTED_ERROR,
+    HD_RPR_DEBUG_IMAGE_CACHE,
+    HD_RPR_DEBUG_MATERIAL_CACHE
 );
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -63,6 +63,9 @@ void HdRprDomeLight::Sync(HdSceneDelegate* sceneDelegate,
 
     bool newLight = false;
     if (bits & HdLight::DirtyParams) {
+        // The old light is released only after the new one is created,
+        // so that its texture is picked up from the image cache when it's not changed
+        auto oldLight = m_rprLight;
         m_rprLight = nullptr;
 
         float intensity = sceneDelegate->GetLightParamValue(id, HdLightTokens->intensity).Get<float>();
@@ -99,6 +102,10 @@ void HdRprDomeLight::Sync(HdSceneDelegate* sceneDelegate,
             m_rprLight = rprApi->CreateEnvironmentLight(texturePath, computedIntensity);
         }
 
+        if (oldLight) {
+            rprApi->Release(oldLight);
+        }
+
         if (m_rprLight) {
             newLight = true;
         }
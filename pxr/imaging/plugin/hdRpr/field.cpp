@@ -12,21 +12,105 @@ limitations under the License.
 ************************************************************************/
 
 #include "field.h"
+#include "vdbGridCache.h"
+
+#include "pxr/usd/ar/resolver.h"
+#include "pxr/usd/sdf/assetPath.h"
+
+#include <atomic>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
-HdRprField::HdRprField(SdfPath const& id) : HdField(id) {
+TF_DEFINE_PRIVATE_TOKENS(
+    HdRprFieldTokens,
+    (filePath) \
+    (temperatureOffset) \
+    (temperatureScale)
+);
+
+namespace {
+
+uint64_t GetNextFieldVersion() {
+    static std::atomic<uint64_t> s_version(0);
+    return ++s_version;
+}
+
+std::string GetVdbGridPath(SdfAssetPath const& assetPath) {
+    if (IsHoudiniGridPath(assetPath.GetAssetPath())) {
+        return assetPath.GetAssetPath();
+    } else if (assetPath.GetResolvedPath().empty()) {
+        return ArGetResolver().Resolve(assetPath.GetAssetPath());
+    } else {
+        return assetPath.GetResolvedPath();
+    }
+}
+
+} // namespace anonymous
+
+HdRprField::HdRprField(SdfPath const& id)
+    : HdField(id)
+    , m_version(GetNextFieldVersion()) {
 
 }
 
 void HdRprField::Sync(HdSceneDelegate* sceneDelegate,
                       HdRenderParam* renderParam,
                       HdDirtyBits* dirtyBits) {
+    if (*dirtyBits & DirtyParams) {
+        auto& id = GetId();
+
+        m_filePath.clear();
+        auto filePath = sceneDelegate->Get(id, HdRprFieldTokens->filePath);
+        if (filePath.IsHolding<SdfAssetPath>()) {
+            m_filePath = GetVdbGridPath(filePath.UncheckedGet<SdfAssetPath>());
+        }
+
+        m_temperatureOffset = sceneDelegate->Get(id, HdRprFieldTokens->temperatureOffset).GetWithDefault(0.0f);
+        m_temperatureScale = sceneDelegate->Get(id, HdRprFieldTokens->temperatureScale).GetWithDefault(1.0f);
+
+        {
+            std::lock_guard<std::mutex> lock(m_gridsMutex);
+            m_grids.clear();
+        }
+        m_version = GetNextFieldVersion();
+    }
+
+    *dirtyBits = DirtyBits::Clean;
+}
+
+openvdb::GridBase::ConstPtr HdRprField::GetGrid(std::string const& gridName, int downsampleFactor) {
+    if (m_filePath.empty()) {
+        return nullptr;
+    }
+
+    if (IsHoudiniGridPath(m_filePath)) {
+        // Houdini owns the grid and may free it when SOP recooks, so it's looked up on every request
+        return VdbGridCache::GetInstance().GetGrid(m_filePath, gridName, downsampleFactor);
+    }
+
+    std::lock_guard<std::mutex> lock(m_gridsMutex);
+
+    auto key = std::make_pair(gridName, downsampleFactor);
+    auto it = m_grids.find(key);
+    if (it != m_grids.end()) {
+        return it->second;
+    }
+
+    auto grid = VdbGridCache::GetInstance().GetGrid(m_filePath, gridName, downsampleFactor);
+    m_grids.emplace(key, grid);
+    return grid;
+}
+
+size_t HdRprField::GetActiveVoxelCount(std::string const& gridName) const {
+    if (m_filePath.empty()) {
+        return 0;
+    }
 
+    return VdbGridCache::GetInstance().GetActiveVoxelCount(m_filePath, gridName);
 }
 
 HdDirtyBits HdRprField::GetInitialDirtyBitsMask() const {
-    return DirtyBits::Clean;
+    return DirtyBits::DirtyParams;
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -16,6 +16,12 @@ limitations under the License.
 
 #include "pxr/imaging/hd/field.h"
 
+#include <openvdb/openvdb.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 class HdRprField : public HdField {
@@ -28,6 +34,32 @@ public:
               HdDirtyBits* dirtyBits) override;
 
     HdDirtyBits GetInitialDirtyBitsMask() const override;
+
+    /// Resolved path to .vdb file or path to Houdini SOP ("op:" prefix)
+    std::string const& GetFilePath() const { return m_filePath; }
+
+    float GetTemperatureOffset() const { return m_temperatureOffset; }
+    float GetTemperatureScale() const { return m_temperatureScale; }
+
+    /// Changes each time the field is changed, volumes compare it to know which of their channels are outdated.
+    /// Versions are unique across all fields, so a field recreated with the same id never matches old channels
+    uint64_t GetVersion() const { return m_version; }
+
+    /// Returns grid of the field. Grids are kept loaded until the field is changed, except Houdini SOP grids.
+    /// Can be called concurrently by the volumes that reference the field
+    openvdb::GridBase::ConstPtr GetGrid(std::string const& gridName, int downsampleFactor = 1);
+
+    /// Returns the number of active voxels of the full resolution grid without loading it when possible
+    size_t GetActiveVoxelCount(std::string const& gridName) const;
+
+private:
+    std::string m_filePath;
+    float m_temperatureOffset = 0.0f;
+    float m_temperatureScale = 1.0f;
+    uint64_t m_version;
+
+    std::mutex m_gridsMutex;
+    std::map<std::pair<std::string, int>, openvdb::GridBase::ConstPtr> m_grids;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,124 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+
+#include "fileWatcher.h"
+
+#include "pxr/base/tf/pathUtils.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#endif // __linux__
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher() {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+FileWatcher::~FileWatcher() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool FileWatcher::Watch(std::string const& filePath) {
+    if (m_fd < 0) {
+        return false;
+    }
+
+    // Directory is kept with the trailing separator so that changed paths are concatenated back exactly as they were watched
+    auto directory = TfGetPathName(filePath);
+    if (m_directoryWatches.count(directory)) {
+        return true;
+    }
+
+    static const uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+    int wd = inotify_add_watch(m_fd, directory.empty() ? "." : directory.c_str(), kWatchMask);
+    if (wd < 0) {
+        // Most likely the limit of watches is reached
+        return false;
+    }
+
+    m_directoryWatches.emplace(directory, wd);
+    m_watchedDirectories[wd] = directory;
+    return true;
+}
+
+bool FileWatcher::ReadChanges(std::unordered_set<std::string>* changedFiles) {
+    if (m_fd < 0) {
+        return true;
+    }
+
+    bool isComplete = true;
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    while (true) {
+        auto length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            auto event = reinterpret_cast<inotify_event const*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                isComplete = false;
+                continue;
+            }
+
+            auto it = m_watchedDirectories.find(event->wd);
+            if (it == m_watchedDirectories.end()) {
+                continue;
+            }
+
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // The directory itself is gone, files in it can not be tracked anymore
+                if (event->mask & IN_IGNORED) {
+                    m_directoryWatches.erase(it->second);
+                    m_watchedDirectories.erase(it);
+                }
+                isComplete = false;
+                continue;
+            }
+
+            if (event->len) {
+                changedFiles->insert(it->second + event->name);
+            }
+        }
+    }
+
+    return isComplete;
+}
+
+#else
+
+FileWatcher::FileWatcher() = default;
+FileWatcher::~FileWatcher() = default;
+
+bool FileWatcher::Watch(std::string const& filePath) {
+    return false;
+}
+
+bool FileWatcher::ReadChanges(std::unordered_set<std::string>* changedFiles) {
+    return true;
+}
+
+#endif // __linux__
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,50 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+
+#ifndef HDRPR_FILE_WATCHER_H
+#define HDRPR_FILE_WATCHER_H
+
+#include "pxr/pxr.h"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Watches files for changes by watching their parent directories with inotify.
+/// Available only on Linux, on other platforms the watcher is disabled
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    bool IsEnabled() const { return m_fd >= 0; }
+
+    /// Starts watching the directory containing the file. Returns false if changes of the file can not be tracked
+    bool Watch(std::string const& filePath);
+
+    /// Collects paths of changed files in watched directories. Does not block.
+    /// Returns false when some changes were lost and all watched files should be considered changed
+    bool ReadChanges(std::unordered_set<std::string>* changedFiles);
+
+private:
+    int m_fd = -1;
+    std::unordered_map<std::string, int> m_directoryWatches;
+    std::unordered_map<int, std::string> m_watchedDirectories;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_FILE_WATCHER_H
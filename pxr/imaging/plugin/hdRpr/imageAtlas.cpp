@@ -0,0 +1,296 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#include "imageAtlas.h"
+#include "rpr/error.h"
+#include "rpr/imageHelpers.h"
+
+#include "pxr/imaging/glf/image.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <algorithm>
+#include <cstring>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_ATLAS, false,
+    "Pack small textures with clamp wrap mode into shared atlas pages");
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_ATLAS_MAX_SIZE, 128,
+    "Largest dimension of textures that are packed into the texture atlas");
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_ATLAS_PAGE_SIZE, 2048,
+    "Width and height of texture atlas pages");
+
+namespace {
+
+/// Edge pixels replicated around each region so that bilinear filtering does not pick up neighbours
+const uint32_t kRegionPadding = 2;
+
+size_t GetComponentSize(rpr_component_type type) {
+    if (type == RPR_COMPONENT_TYPE_FLOAT16) {
+        return 2;
+    } else if (type == RPR_COMPONENT_TYPE_FLOAT32) {
+        return 4;
+    }
+    return 1;
+}
+
+} // namespace anonymous
+
+std::unique_ptr<ImageAtlas> ImageAtlas::Create(ImageCache* imageCache) {
+    if (!TfGetEnvSetting(HDRPR_TEXTURE_ATLAS)) {
+        return nullptr;
+    }
+
+    int pageSize = TfGetEnvSetting(HDRPR_TEXTURE_ATLAS_PAGE_SIZE);
+    int maxTextureSize = TfGetEnvSetting(HDRPR_TEXTURE_ATLAS_MAX_SIZE);
+    if (maxTextureSize <= 0 || pageSize < maxTextureSize + 2 * int(kRegionPadding)) {
+        TF_RUNTIME_ERROR("Texture atlas is disabled: page size %d can not fit textures of size %d", pageSize, maxTextureSize);
+        return nullptr;
+    }
+
+    return std::unique_ptr<ImageAtlas>(new ImageAtlas(imageCache, uint32_t(pageSize), uint32_t(maxTextureSize)));
+}
+
+ImageAtlas::ImageAtlas(ImageCache* imageCache, uint32_t pageSize, uint32_t maxTextureSize)
+    : m_imageCache(imageCache)
+    , m_pageSize(pageSize)
+    , m_maxTextureSize(maxTextureSize) {
+
+}
+
+std::string ImageAtlas::GetKey(std::string const& path, ImageCache::ImageVariant const& variant) const {
+    auto& s = variant.scale;
+    auto& b = variant.bias;
+    return TfStringPrintf("%s?l%d?c%d?s%.9g,%.9g,%.9g,%.9g?b%.9g,%.9g,%.9g,%.9g", path.c_str(),
+        int(variant.forceLinearSpace), variant.channel, s[0], s[1], s[2], s[3], b[0], b[1], b[2], b[3]);
+}
+
+bool ImageAtlas::IsSmallImage(std::string const& path) {
+    if (m_largeImages.count(path)) {
+        return false;
+    }
+
+    // Only the header is read, so large images are rejected without decoding
+    auto image = GlfImage::IsSupportedImageFile(path) ? GlfImage::OpenForReading(path) : nullptr;
+    if (!image ||
+        image->GetWidth() > int(m_maxTextureSize) ||
+        image->GetHeight() > int(m_maxTextureSize)) {
+        m_largeImages.insert(path);
+        return false;
+    }
+    return true;
+}
+
+bool ImageAtlas::Add(std::string const& path, ImageCache::ImageVariant const& variant, Region* outRegion) {
+    auto key = GetKey(path, variant);
+
+    auto entryIt = m_entries.find(key);
+    if (entryIt != m_entries.end()) {
+        auto& entry = entryIt->second;
+        if (m_imageCache->IsFileUpToDate(entry.md)) {
+            *outRegion = {entry.page, entry.uvTransform, entry.isCommitted};
+            return true;
+        }
+
+        // The file has changed, the texture is packed into a new region.
+        // The old region stays allocated while materials created before the change use it
+        auto& keys = m_pages.at(entry.page).keys;
+        keys.erase(std::remove(keys.begin(), keys.end(), key), keys.end());
+        m_entries.erase(entryIt);
+    }
+
+    if (!IsSmallImage(path)) {
+        return false;
+    }
+
+    // Captured before the file is read, so that changes made during decoding are not missed
+    ImageCache::ImageMetadata md(path);
+    md.path = path;
+    md.validationTime = std::chrono::steady_clock::now();
+
+    // Small images are decoded right away, the resolution limit does not apply to them
+    auto fullResolutionVariant = variant;
+    fullResolutionVariant.maxResolution = 0;
+
+    rpr::ImageData data;
+    if (!m_imageCache->LoadImageData(path, fullResolutionVariant, &data) ||
+        data.width > m_maxTextureSize || data.height > m_maxTextureSize) {
+        m_largeImages.insert(path);
+        return false;
+    }
+
+    uint32_t allocationWidth = data.width + 2 * kRegionPadding;
+    uint32_t allocationHeight = data.height + 2 * kRegionPadding;
+
+    uint32_t pageId = 0;
+    Page* page = nullptr;
+    uint32_t x, y;
+    for (auto& entry : m_pages) {
+        auto& candidate = entry.second;
+        if (candidate.format.type == data.format.type &&
+            candidate.format.num_components == data.format.num_components &&
+            candidate.gamma == data.gamma &&
+            candidate.Allocate(allocationWidth, allocationHeight, m_pageSize, &x, &y)) {
+            pageId = entry.first;
+            page = &candidate;
+            break;
+        }
+    }
+    if (!page) {
+        pageId = m_nextPageId++;
+        page = &m_pages[pageId];
+        page->format = data.format;
+        page->gamma = data.gamma;
+        page->pixelSize = data.format.num_components * GetComponentSize(data.format.type);
+        page->pixels.resize(size_t(m_pageSize) * m_pageSize * page->pixelSize);
+        if (!page->Allocate(allocationWidth, allocationHeight, m_pageSize, &x, &y)) {
+            m_pages.erase(pageId);
+            return false;
+        }
+        UpdateMemoryUsage();
+    }
+
+    // Copy the image with its edges replicated into the padding
+    auto pixelSize = page->pixelSize;
+    auto srcPixels = static_cast<uint8_t const*>(data.data);
+    for (uint32_t py = 0; py < allocationHeight; ++py) {
+        uint32_t srcY = uint32_t(std::min(std::max(int(py) - int(kRegionPadding), 0), int(data.height) - 1));
+        auto srcRow = srcPixels + size_t(srcY) * data.width * pixelSize;
+        auto dstRow = page->pixels.data() + (size_t(y + py) * m_pageSize + x) * pixelSize;
+
+        for (uint32_t px = 0; px < kRegionPadding; ++px) {
+            std::memcpy(dstRow + px * pixelSize, srcRow, pixelSize);
+            std::memcpy(dstRow + (kRegionPadding + data.width + px) * pixelSize, srcRow + (data.width - 1) * pixelSize, pixelSize);
+        }
+        std::memcpy(dstRow + kRegionPadding * pixelSize, srcRow, data.width * pixelSize);
+    }
+    page->usedPixels += size_t(data.width) * data.height;
+    page->keys.push_back(key);
+    page->isDirty = true;
+
+    // Row 0 of RPR images is sampled at the top (v = 1)
+    float scale = 1.0f / m_pageSize;
+    float regionX = float(x + kRegionPadding);
+    float regionY = float(y + kRegionPadding);
+    GfMatrix3f uvTransform(
+        data.width * scale, 0.0f, regionX * scale,
+        0.0f, data.height * scale, (m_pageSize - regionY - data.height) * scale,
+        0.0f, 0.0f, 1.0f);
+
+    m_entries.emplace(key, Entry{pageId, uvTransform, false, std::move(md)});
+    *outRegion = {pageId, uvTransform, false};
+    return true;
+}
+
+bool ImageAtlas::Page::Allocate(uint32_t width, uint32_t height, uint32_t pageSize, uint32_t* outX, uint32_t* outY) {
+    if (width > pageSize || height > pageSize) {
+        return false;
+    }
+
+    // Shelf packing: the first shelf that is high enough and has space left
+    for (auto& shelf : shelves) {
+        if (height <= shelf.height && shelf.width + width <= pageSize) {
+            *outX = shelf.width;
+            *outY = shelf.y;
+            shelf.width += width;
+            return true;
+        }
+    }
+
+    if (shelvesHeight + height > pageSize) {
+        return false;
+    }
+
+    shelves.push_back({shelvesHeight, height, width});
+    *outX = 0;
+    *outY = shelvesHeight;
+    shelvesHeight += height;
+    return true;
+}
+
+std::shared_ptr<rpr::Image> ImageAtlas::GetPageImage(uint32_t page) const {
+    auto it = m_pages.find(page);
+    return it != m_pages.end() ? it->second.image : nullptr;
+}
+
+std::vector<uint32_t> ImageAtlas::CommitPages() {
+    std::vector<uint32_t> committedPages;
+    for (auto& entry : m_pages) {
+        auto& page = entry.second;
+        if (!page.isDirty) {
+            continue;
+        }
+        page.isDirty = false;
+
+        rpr::ImageData data;
+        data.format = page.format;
+        data.width = m_pageSize;
+        data.height = m_pageSize;
+        data.data = page.pixels.data();
+        data.gamma = page.gamma;
+
+        std::shared_ptr<rpr::Image> image(rpr::CreateImage(m_imageCache->GetContext(), data));
+        if (!image) {
+            continue;
+        }
+        RPR_ERROR_CHECK(image->SetWrap(RPR_IMAGE_WRAP_TYPE_CLAMP_TO_EDGE), "Failed to set image wrap mode");
+
+        page.image = std::move(image);
+        for (auto& key : page.keys) {
+            m_entries.at(key).isCommitted = true;
+        }
+        committedPages.push_back(entry.first);
+    }
+    return committedPages;
+}
+
+bool ImageAtlas::HasUncommittedPages() const {
+    return std::any_of(m_pages.begin(), m_pages.end(), [](std::pair<const uint32_t, Page> const& entry) {
+        return entry.second.isDirty;
+    });
+}
+
+void ImageAtlas::ReleasePage(uint32_t page) {
+    auto it = m_pages.find(page);
+    if (it == m_pages.end()) {
+        return;
+    }
+
+    for (auto& key : it->second.keys) {
+        m_entries.erase(key);
+    }
+    m_pages.erase(it);
+    UpdateMemoryUsage();
+}
+
+void ImageAtlas::UpdateMemoryUsage() {
+    size_t memoryUsage = 0;
+    for (auto& entry : m_pages) {
+        memoryUsage += entry.second.pixels.size();
+    }
+    m_imageCache->SetExternalMemoryUsage(memoryUsage);
+}
+
+ImageAtlas::Stats ImageAtlas::GetStats() const {
+    Stats stats;
+    stats.numPages = m_pages.size();
+    stats.numTextures = m_entries.size();
+    for (auto& entry : m_pages) {
+        stats.usedPixels += entry.second.usedPixels;
+    }
+    stats.totalPixels = stats.numPages * m_pageSize * m_pageSize;
+    return stats;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,125 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#ifndef HDRPR_IMAGE_ATLAS_H
+#define HDRPR_IMAGE_ATLAS_H
+
+#include "imageCache.h"
+
+#include "pxr/pxr.h"
+#include "pxr/base/gf/matrix3f.h"
+
+#include <RadeonProRender.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Packs small textures into shared pages so that scenes with thousands of tiny textures
+/// do not create an RPR image per texture. Textures are addressed by the UV transform of their region.
+/// Pages are grouped by pixel format and are recreated in RPR on commit when new textures are added.
+/// Materials clamp UVs to [0, 1] before the region transform and the padding around the region keeps
+/// filtering at its edges from reaching neighbours, so the atlas is used only for textures with clamp wrap mode
+class ImageAtlas {
+public:
+    /// Returns nullptr if the atlas is disabled by HDRPR_TEXTURE_ATLAS
+    static std::unique_ptr<ImageAtlas> Create(ImageCache* imageCache);
+
+    struct Region {
+        uint32_t page;
+        /// Maps texture UVs to the region in the page
+        GfMatrix3f uvTransform;
+        /// Whether the page image already contains the region
+        bool isCommitted;
+    };
+
+    /// Packs the image of the variant into one of the pages. Returns false if the image is not small enough
+    /// or can not be decoded, such images should be loaded separately
+    bool Add(std::string const& path, ImageCache::ImageVariant const& variant, Region* outRegion);
+
+    std::shared_ptr<rpr::Image> GetPageImage(uint32_t page) const;
+
+    /// Recreates RPR images of pages with newly added textures. Returns ids of recreated pages
+    std::vector<uint32_t> CommitPages();
+    bool HasUncommittedPages() const;
+
+    /// Drops the page and all its regions, should be called when no material uses the page
+    void ReleasePage(uint32_t page);
+
+    struct Stats {
+        size_t numPages = 0;
+        size_t numTextures = 0;
+        size_t usedPixels = 0;
+        size_t totalPixels = 0;
+    };
+    Stats GetStats() const;
+
+private:
+    ImageAtlas(ImageCache* imageCache, uint32_t pageSize, uint32_t maxTextureSize);
+
+    struct Shelf {
+        uint32_t y;
+        uint32_t height;
+        uint32_t width;
+    };
+
+    struct Page {
+        rpr::ImageFormat format;
+        float gamma;
+        size_t pixelSize;
+        std::vector<uint8_t> pixels;
+
+        std::vector<Shelf> shelves;
+        uint32_t shelvesHeight = 0;
+        size_t usedPixels = 0;
+
+        std::vector<std::string> keys;
+        std::shared_ptr<rpr::Image> image;
+        bool isDirty = false;
+
+        bool Allocate(uint32_t width, uint32_t height, uint32_t pageSize, uint32_t* outX, uint32_t* outY);
+    };
+
+    struct Entry {
+        uint32_t page;
+        GfMatrix3f uvTransform;
+        bool isCommitted;
+        /// Metadata of the file when the region was packed, validated by the image cache
+        ImageCache::ImageMetadata md;
+    };
+
+    std::string GetKey(std::string const& path, ImageCache::ImageVariant const& variant) const;
+    bool IsSmallImage(std::string const& path);
+    /// Reports CPU copies of page pixels to the image cache memory budget
+    void UpdateMemoryUsage();
+
+private:
+    ImageCache* m_imageCache;
+    uint32_t m_pageSize;
+    uint32_t m_maxTextureSize;
+
+    std::map<uint32_t, Page> m_pages;
+    uint32_t m_nextPageId = 0;
+
+    std::unordered_map<std::string, Entry> m_entries;
+    std::unordered_set<std::string> m_largeImages;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_IMAGE_ATLAS_H
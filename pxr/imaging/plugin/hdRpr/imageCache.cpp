@@ -12,53 +12,516 @@ limitations under the License.
 ************************************************************************/
 
 #include "imageCache.h"
+#include "debugCodes.h"
 #include "rpr/helpers.h"
 #include "rpr/imageHelpers.h"
 
 #include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <fstream>
+#include <iterator>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
-ImageCache::ImageCache(rpr::Context* context)
-    : m_context(context) {
+TF_DEFINE_ENV_SETTING(HDRPR_IMAGE_CACHE_SIZE_MB, 512,
+    "Maximum amount of memory in megabytes that can be used to keep unreferenced images loaded");
+TF_DEFINE_ENV_SETTING(HDRPR_IMAGE_CACHE_VALIDATION, "stat",
+    "How cached images are validated against their files: "
+    "stat - file is checked on each lookup, "
+    "watch - file changes are tracked with inotify on Linux, files that can not be watched are validated periodically, "
+    "periodic - file is checked at most once per HDRPR_IMAGE_CACHE_REVALIDATION_INTERVAL");
+TF_DEFINE_ENV_SETTING(HDRPR_IMAGE_CACHE_REVALIDATION_INTERVAL, 10,
+    "Interval in seconds between validations of cached images in periodic validation mode");
+TF_DEFINE_ENV_SETTING(HDRPR_ASYNC_TEXTURE_MAX_UPDATES, 2,
+    "Maximum number of times textures loaded in background are swapped in while other textures are still loading");
+
+namespace {
 
+bool IsLinearGamma(float gamma) {
+    return gamma <= 0.0f || std::abs(gamma - 1.0f) < 0.01f;
 }
 
-std::shared_ptr<rpr::Image> ImageCache::GetImage(std::string const& path, bool forceLinearSpace) {
-    ImageMetadata md(path);
+size_t GetImageMemoryUsage(rpr::Image* image) {
+    auto desc = rpr::GetImageDesc(image);
+    return size_t(desc.image_slice_pitch) * std::max(desc.image_depth, 1u);
+}
+
+int GetMaxIntermediateCommits() {
+    static const int kMaxIntermediateCommits = std::max(TfGetEnvSetting(HDRPR_ASYNC_TEXTURE_MAX_UPDATES), 0);
+    return kMaxIntermediateCommits;
+}
 
-    auto cacheKey = path;
+const auto kMinIntermediateCommitInterval = std::chrono::seconds(1);
 
+} // namespace anonymous
+
+ImageCache::ImageCache(rpr::Context* context, std::string const& diskCacheDirectory)
+    : m_context(context)
+    , m_diskCache(diskCacheDirectory) {
+    m_memoryBudget = size_t(std::max(TfGetEnvSetting(HDRPR_IMAGE_CACHE_SIZE_MB), 0)) * 1024 * 1024;
+
+    auto validationMode = TfGetEnvSetting(HDRPR_IMAGE_CACHE_VALIDATION);
+    if (validationMode == "watch") {
+        m_validationMode = m_fileWatcher.IsEnabled() ? kValidationWatch : kValidationPeriodic;
+    } else if (validationMode == "periodic") {
+        m_validationMode = kValidationPeriodic;
+    } else {
+        if (validationMode != "stat") {
+            TF_WARN("Unknown HDRPR_IMAGE_CACHE_VALIDATION value: %s. Using \"stat\"", validationMode.c_str());
+        }
+        m_validationMode = kValidationStat;
+    }
+    m_revalidationInterval = std::chrono::seconds(std::max(TfGetEnvSetting(HDRPR_IMAGE_CACHE_REVALIDATION_INTERVAL), 0));
+}
+
+ImageCache::~ImageCache() {
+    m_loadDispatcher.Cancel();
+    m_loadDispatcher.Wait();
+}
+
+std::string ImageCache::GetCacheKey(std::string const& path, ImageVariant const& variant) {
     static const char* kForceLinearSpaceCacheKeySuffix = "?l";
-    if (forceLinearSpace) {
-        cacheKey += kForceLinearSpaceCacheKeySuffix;
+    auto cacheKey = variant.forceLinearSpace ? path + kForceLinearSpaceCacheKeySuffix : path;
+    if (variant.maxResolution) {
+        cacheKey += TfStringPrintf("?r%u", variant.maxResolution);
+    }
+    if (variant.channel >= 0) {
+        cacheKey += TfStringPrintf("?c%d", variant.channel);
+    }
+    if (variant.IsBaked()) {
+        auto& s = variant.scale;
+        auto& b = variant.bias;
+        cacheKey += TfStringPrintf("?s%.9g,%.9g,%.9g,%.9g?b%.9g,%.9g,%.9g,%.9g", s[0], s[1], s[2], s[3], b[0], b[1], b[2], b[3]);
     }
+    return cacheKey;
+}
+
+std::string ImageCache::GetDiskCacheKey(std::string const& path, ImageMetadata const& md, ImageVariant const& variant) const {
+    // Modification time is printed exactly to not miss sub-second changes
+    auto& s = variant.scale;
+    auto& b = variant.bias;
+    return TfStringPrintf("%s\n%zu\n%a\n%s\n%u\n%d\n%a,%a,%a,%a\n%a,%a,%a,%a", path.c_str(), md.GetFileSize(), md.GetModificationTime(),
+        variant.forceLinearSpace ? "l" : "", variant.maxResolution, variant.channel, s[0], s[1], s[2], s[3], b[0], b[1], b[2], b[3]);
+}
+
+bool ImageCache::IsConversionSupported(std::string const& path) {
+    // Only images decoded by us can be converted
+    return rpr::IsDecodableImage(path.c_str());
+}
 
+bool ImageCache::LoadImageData(std::string const& path, ImageVariant const& variant, rpr::ImageData* outData) const {
+    return LoadImageData(path, ImageMetadata(path), variant, outData);
+}
+
+bool ImageCache::LoadImageData(std::string const& path, ImageMetadata const& md, ImageVariant const& variant, rpr::ImageData* outData) const {
+    // Files without metadata (e.g. failed to stat) can not be validated later, so they are not cached
+    bool useDiskCache = m_diskCache.IsEnabled() && md.GetFileSize() != 0;
+
+    std::string diskCacheKey;
+    if (useDiskCache) {
+        diskCacheKey = GetDiskCacheKey(path, md, variant);
+        if (m_diskCache.Load(diskCacheKey, outData)) {
+            return true;
+        }
+    }
+
+    if (!rpr::DecodeImage(path.c_str(), variant.forceLinearSpace, outData, variant.maxResolution)) {
+        return false;
+    }
+    if (variant.IsBaked() || variant.channel == rpr::kImageChannelLuminance) {
+        // Luminance is computed from linear values too
+        if (!rpr::ConvertImage(outData, variant.scale.data(), variant.bias.data(), variant.channel)) {
+            return false;
+        }
+    } else if (variant.channel >= 0 && !rpr::ExtractImageChannel(outData, variant.channel)) {
+        return false;
+    }
+
+    if (useDiskCache) {
+        // The image does not wait for its file to be written, the copy keeps decoded pixels alive until then
+        auto data = *outData;
+        m_loadDispatcher.Run([this, diskCacheKey, data]() {
+            m_diskCache.Store(diskCacheKey, data);
+        });
+    }
+    return true;
+}
+
+std::shared_ptr<rpr::Image> ImageCache::Find(std::string const& cacheKey) {
     auto it = m_cache.find(cacheKey);
-    if (it != m_cache.end() && it->second.IsMetadataEqual(md)) {
+    if (it != m_cache.end() && IsUpToDate(it->second)) {
         if (auto image = it->second.handle.lock()) {
+            Retain(image, it->second.memoryUsage);
             return image;
         }
     }
+    return nullptr;
+}
 
-    auto image = std::shared_ptr<rpr::Image>(rpr::CreateImage(m_context, path.c_str(), forceLinearSpace));
-    if (image) {
-        md.handle = image;
-        m_cache.emplace(cacheKey, md);
-
-        auto gammaFromFile = rpr::GetInfo<float>(image.get(), RPR_IMAGE_GAMMA_FROM_FILE);
-        if (std::abs(gammaFromFile - 1.0f) < 0.01f) {
-            // Image is in linear space, we can cache the same image for both variants of forceLinearSpace
-            if (forceLinearSpace) {
-                m_cache.emplace(path, md);
-            } else {
-                m_cache.emplace(path + kForceLinearSpaceCacheKeySuffix, md);
-            }
+bool ImageCache::IsUpToDate(ImageMetadata& md) {
+    if (md.isWatched) {
+        return true;
+    }
+
+    auto validationTime = md.validationTime;
+    if (!IsFileUpToDate(md)) {
+        return false;
+    }
+    if (m_validationMode == kValidationWatch && md.validationTime != validationTime) {
+        md.isWatched = m_fileWatcher.Watch(md.path);
+    }
+    return true;
+}
+
+bool ImageCache::IsFileUpToDate(ImageMetadata& md) {
+    if (m_validationMode == kValidationStat) {
+        return md.IsMetadataEqual(ImageMetadata(md.path));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - md.validationTime < m_revalidationInterval) {
+        return true;
+    }
+
+    if (!md.IsMetadataEqual(ImageMetadata(md.path))) {
+        return false;
+    }
+    md.validationTime = now;
+    return true;
+}
+
+void ImageCache::ProcessFileChanges() {
+    if (m_validationMode != kValidationWatch) {
+        return;
+    }
+
+    m_changedFiles.clear();
+    bool isComplete = m_fileWatcher.ReadChanges(&m_changedFiles);
+    if (isComplete && m_changedFiles.empty()) {
+        return;
+    }
+
+    // Changed files are validated on the next lookup, the change might not affect file content, e.g. touch
+    auto invalidate = [this, isComplete](ImageMetadata& md) {
+        if (!isComplete || m_changedFiles.count(md.path)) {
+            md.isWatched = false;
+            md.validationTime = std::chrono::steady_clock::time_point();
         }
+    };
+    for (auto& entry : m_cache) {
+        invalidate(entry.second);
+    }
+    for (auto& entry : m_iesProfiles) {
+        invalidate(entry.second.md);
+    }
+}
+
+std::shared_ptr<rpr::Image> ImageCache::GetLoadedImage(std::string const& path, ImageVariant const& variant) {
+    ProcessFileChanges();
+
+    if (auto image = Find(GetCacheKey(path, variant))) {
+        return image;
+    }
+    if (variant.maxResolution) {
+        // There is no point in loading smaller version of the image that is already loaded
+        auto fullResolutionVariant = variant;
+        fullResolutionVariant.maxResolution = 0;
+        return Find(GetCacheKey(path, fullResolutionVariant));
+    }
+    return nullptr;
+}
+
+std::shared_ptr<rpr::Image> ImageCache::GetImage(std::string const& path, ImageVariant const& variant) {
+    if (auto image = GetLoadedImage(path, variant)) {
+        m_stats.numHits++;
+        return image;
+    }
+
+    m_stats.numMisses++;
+
+    ImageMetadata md(path);
+    std::shared_ptr<rpr::Image> image;
+    rpr::ImageData data;
+    if (LoadImageData(path, md, variant, &data)) {
+        image.reset(rpr::CreateImage(m_context, data));
+        md.isDownsampled = data.isDownsampled;
+        // Converted images are linearized, the source color space is unknown then
+        md.isLinear = !variant.forceLinearSpace && !variant.IsConverted() && IsLinearGamma(data.gamma);
+    } else if (!variant.IsConverted()) {
+        // Let RPR try to load it
+        image.reset(m_context->CreateImageFromFile(path.c_str()));
+        md.isLinear = image && IsLinearGamma(rpr::GetInfo<float>(image.get(), RPR_IMAGE_GAMMA_FROM_FILE));
+    }
+
+    if (image) {
+        Insert(path, variant, md, image);
     }
     return image;
 }
 
+void ImageCache::Insert(std::string const& path, ImageVariant const& variant, ImageMetadata md, std::shared_ptr<rpr::Image> const& image) {
+    md.handle = image;
+    md.memoryUsage = GetImageMemoryUsage(image.get());
+    md.path = path;
+    md.validationTime = std::chrono::steady_clock::now();
+    if (m_validationMode == kValidationWatch) {
+        // The file could have been changed after it was loaded but before the watch was started
+        md.isWatched = m_fileWatcher.Watch(path) && md.IsMetadataEqual(ImageMetadata(path));
+    }
+
+    // Image in linear space can be used for both variants of forceLinearSpace
+    bool isLinear = md.isLinear;
+    // Image that fits into resolution limit is a full resolution image
+    bool isFullResolution = !md.isDownsampled;
+
+    auto aliasVariant = variant;
+    m_cache[GetCacheKey(path, aliasVariant)] = md;
+    if (isLinear) {
+        aliasVariant.forceLinearSpace = !variant.forceLinearSpace;
+        m_cache[GetCacheKey(path, aliasVariant)] = md;
+    }
+    if (variant.maxResolution && isFullResolution) {
+        aliasVariant.maxResolution = 0;
+        aliasVariant.forceLinearSpace = variant.forceLinearSpace;
+        m_cache[GetCacheKey(path, aliasVariant)] = md;
+        if (isLinear) {
+            aliasVariant.forceLinearSpace = !variant.forceLinearSpace;
+            m_cache[GetCacheKey(path, aliasVariant)] = md;
+        }
+    }
+
+    Retain(image, md.memoryUsage);
+}
+
+std::shared_ptr<rpr::Image> ImageCache::GetImageAsync(std::string const& path, ImageVariant const& variant) {
+    auto cacheKey = GetCacheKey(path, variant);
+    if (m_loadingImages.count(cacheKey)) {
+        return nullptr;
+    }
+
+    if (auto image = GetLoadedImage(path, variant)) {
+        m_stats.numHits++;
+        return image;
+    }
+
+    if (!rpr::IsDecodableImage(path.c_str())) {
+        return GetImage(path, variant);
+    }
+
+    m_stats.numMisses++;
+
+    auto loadingImage = std::make_shared<LoadingImage>();
+    loadingImage->path = path;
+    loadingImage->variant = variant;
+    loadingImage->md = ImageMetadata(path);
+    loadingImage->data.reset(new rpr::ImageData);
+    m_loadingImages.emplace(cacheKey, loadingImage);
+
+    if (m_loadingImages.size() == 1) {
+        // First image of the loading wave
+        m_numIntermediateCommits = 0;
+        m_lastCommitTime = std::chrono::steady_clock::now();
+    }
+
+    m_loadDispatcher.Run([this, loadingImage]() {
+        loadingImage->isDecoded = LoadImageData(loadingImage->path, loadingImage->md, loadingImage->variant, loadingImage->data.get());
+        loadingImage->isDone = true;
+
+        std::lock_guard<std::mutex> lock(m_loadSignalMutex);
+        m_numDecodedImages++;
+        m_loadSignal.notify_all();
+    });
+
+    return nullptr;
+}
+
+bool ImageCache::IsImageLoading(std::string const& path, ImageVariant const& variant) {
+    return m_loadingImages.count(GetCacheKey(path, variant)) != 0;
+}
+
+bool ImageCache::CommitLoadedImages() {
+    m_committedImages.clear();
+
+    {
+        // Images decoded after this point wake up WaitForLoadedImages even if they are seen below
+        std::lock_guard<std::mutex> lock(m_loadSignalMutex);
+        m_numSeenDecodedImages = m_numDecodedImages;
+    }
+
+    size_t numDone = 0;
+    for (auto& entry : m_loadingImages) {
+        if (entry.second->isDone) {
+            ++numDone;
+        }
+    }
+    if (numDone == 0) {
+        return false;
+    }
+
+    bool isWaveDone = numDone == m_loadingImages.size();
+    auto now = std::chrono::steady_clock::now();
+    if (!isWaveDone &&
+        (m_numIntermediateCommits >= GetMaxIntermediateCommits() ||
+         now - m_lastCommitTime < kMinIntermediateCommitInterval)) {
+        std::lock_guard<std::mutex> lock(m_loadSignalMutex);
+        m_nextCommitTime = m_numIntermediateCommits >= GetMaxIntermediateCommits() ?
+            std::chrono::steady_clock::time_point::max() : m_lastCommitTime + kMinIntermediateCommitInterval;
+        return false;
+    }
+
+    // Images decoded since the scan are committed too
+    size_t numCommitted = 0;
+    for (auto it = m_loadingImages.begin(); it != m_loadingImages.end();) {
+        auto& loadingImage = it->second;
+        if (!loadingImage->isDone) {
+            ++it;
+            continue;
+        }
+        ++numCommitted;
+
+        std::shared_ptr<rpr::Image> image;
+        if (loadingImage->isDecoded) {
+            auto& variant = loadingImage->variant;
+            image.reset(rpr::CreateImage(m_context, *loadingImage->data));
+            loadingImage->md.isDownsampled = loadingImage->data->isDownsampled;
+            loadingImage->md.isLinear = !variant.forceLinearSpace && !variant.IsConverted() && IsLinearGamma(loadingImage->data->gamma);
+        } else if (!loadingImage->variant.IsConverted()) {
+            // Let RPR try to load it
+            image.reset(m_context->CreateImageFromFile(loadingImage->path.c_str()));
+            loadingImage->md.isLinear = image && IsLinearGamma(rpr::GetInfo<float>(image.get(), RPR_IMAGE_GAMMA_FROM_FILE));
+        }
+
+        if (image) {
+            Insert(loadingImage->path, loadingImage->variant, loadingImage->md, image);
+            m_committedImages.push_back(std::move(image));
+        }
+        it = m_loadingImages.erase(it);
+    }
+
+    if (!isWaveDone) {
+        ++m_numIntermediateCommits;
+    }
+    m_lastCommitTime = now;
+
+    {
+        std::lock_guard<std::mutex> lock(m_loadSignalMutex);
+        m_numCommittedImages += numCommitted;
+        m_nextCommitTime = m_numIntermediateCommits >= GetMaxIntermediateCommits() ?
+            std::chrono::steady_clock::time_point::max() : m_lastCommitTime + kMinIntermediateCommitInterval;
+    }
+
+    return true;
+}
+
+bool ImageCache::WaitForLoadedImages(std::chrono::steady_clock::duration timeout) {
+    std::unique_lock<std::mutex> lock(m_loadSignalMutex);
+
+    auto isCommitRequired = [this]() {
+        return m_numDecodedImages != m_numSeenDecodedImages ||
+            (m_numDecodedImages != m_numCommittedImages && std::chrono::steady_clock::now() >= m_nextCommitTime);
+    };
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    if (m_numDecodedImages != m_numCommittedImages) {
+        deadline = std::min(deadline, m_nextCommitTime);
+    }
+    m_loadSignal.wait_until(lock, deadline, [this, &isCommitRequired]() {
+        return m_isWakeUpRequested || isCommitRequired();
+    });
+    m_isWakeUpRequested = false;
+
+    return isCommitRequired();
+}
+
+void ImageCache::WakeUp() {
+    std::lock_guard<std::mutex> lock(m_loadSignalMutex);
+    m_isWakeUpRequested = true;
+    m_loadSignal.notify_all();
+}
+
+std::shared_ptr<std::string const> ImageCache::GetIesProfile(std::string const& path) {
+    ProcessFileChanges();
+
+    auto it = m_iesProfiles.find(path);
+    if (it != m_iesProfiles.end() && IsUpToDate(it->second.md)) {
+        if (auto data = it->second.data.lock()) {
+            m_stats.numHits++;
+            Retain(data, data->size());
+            return data;
+        }
+    }
+
+    m_stats.numMisses++;
+
+    ImageMetadata md(path);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+    auto data = std::make_shared<std::string>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    // TILT keyword separates the free-form header from the photometric data in all versions of the format
+    if (file.bad() || data->find("TILT=") == std::string::npos) {
+        TF_RUNTIME_ERROR("Invalid IES profile: %s", path.c_str());
+        return nullptr;
+    }
+
+    md.path = path;
+    md.memoryUsage = data->size();
+    md.validationTime = std::chrono::steady_clock::now();
+    if (m_validationMode == kValidationWatch) {
+        md.isWatched = m_fileWatcher.Watch(path) && md.IsMetadataEqual(ImageMetadata(path));
+    }
+    m_iesProfiles[path] = {md, data};
+
+    Retain(data, md.memoryUsage);
+    return data;
+}
+
+void ImageCache::SetMemoryBudget(size_t numBytes) {
+    m_memoryBudget = numBytes;
+    EvictIfNeeded();
+}
+
+void ImageCache::SetExternalMemoryUsage(size_t numBytes) {
+    m_stats.externalMemoryUsage = numBytes;
+    EvictIfNeeded();
+}
+
+void ImageCache::Retain(std::shared_ptr<void const> const& object, size_t memoryUsage) {
+    auto it = m_retainedObjectIndex.find(object.get());
+    if (it != m_retainedObjectIndex.end()) {
+        // Move to the front of LRU list
+        m_retainedObjects.splice(m_retainedObjects.begin(), m_retainedObjects, it->second);
+        return;
+    }
+
+    if (memoryUsage > m_memoryBudget) {
+        // Such image would evict everything else, it lives only while materials reference it
+        return;
+    }
+
+    m_retainedObjects.push_front({object, memoryUsage});
+    m_retainedObjectIndex.emplace(object.get(), m_retainedObjects.begin());
+    m_stats.retainedMemoryUsage += memoryUsage;
+
+    EvictIfNeeded();
+}
+
+void ImageCache::EvictIfNeeded() {
+    while (m_stats.retainedMemoryUsage + m_stats.externalMemoryUsage > m_memoryBudget && !m_retainedObjects.empty()) {
+        auto& retainedObject = m_retainedObjects.back();
+        m_stats.retainedMemoryUsage -= retainedObject.memoryUsage;
+        m_stats.numEvictions++;
+        m_retainedObjectIndex.erase(retainedObject.object.get());
+        m_retainedObjects.pop_back();
+
+        // Evicted image might be unreferenced now
+        m_garbageCollectionRequired = true;
+    }
+}
+
 void ImageCache::RequireGarbageCollection() {
     m_garbageCollectionRequired = true;
 }
@@ -77,7 +540,19 @@ void ImageCache::GarbageCollectIfNeeded() {
         }
     }
 
+    auto iesIt = m_iesProfiles.begin();
+    while (iesIt != m_iesProfiles.end()) {
+        if (iesIt->second.data.expired()) {
+            iesIt = m_iesProfiles.erase(iesIt);
+        } else {
+            ++iesIt;
+        }
+    }
+
     m_garbageCollectionRequired = false;
+
+    TF_DEBUG(HD_RPR_DEBUG_IMAGE_CACHE).Msg("Image cache: %zu entries, %zu IES profiles, %zu hits, %zu misses, %zu evictions, %zu bytes retained, %zu bytes external\n",
+        m_cache.size(), m_iesProfiles.size(), m_stats.numHits, m_stats.numMisses, m_stats.numEvictions, m_stats.retainedMemoryUsage, m_stats.externalMemoryUsage);
 }
 
 ImageCache::ImageMetadata::ImageMetadata(std::string const& path) {
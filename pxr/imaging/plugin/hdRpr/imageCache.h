@@ -14,33 +14,113 @@ limitations under the License.
 #ifndef HDRPR_IMAGE_CACHE_H
 #define HDRPR_IMAGE_CACHE_H
 
-#include "pxr/pxr.h"
+#include "imageDiskCache.h"
+#include "fileWatcher.h"
 
+#include "pxr/pxr.h"
+#include "pxr/base/gf/vec4f.h"
+#include "pxr/base/work/dispatcher.h"
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace rpr {
 
 class Context;
 class Image;
+struct ImageData;
 
 } // namespace rpr
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+/// Cache of RPR images and IES profiles loaded from files.
+/// Images are kept alive while they are referenced by materials. Additionally, recently used images are
+/// kept by strong references until their total decoded size exceeds the memory budget, so that materials
+/// that are rebuilt or rebound do not decode the same textures again.
+/// Decoded images are also stored in the disk cache so that next sessions can skip decoding.
+/// Cached images are validated against their files according to HDRPR_IMAGE_CACHE_VALIDATION
 class ImageCache {
 public:
-    ImageCache(rpr::Context* context);
+    /// Empty diskCacheDirectory disables the disk cache
+    ImageCache(rpr::Context* context, std::string const& diskCacheDirectory = std::string());
+    ~ImageCache();
+
+    /// Conversions applied to the image when it's loaded. Each variant of the image is cached separately
+    struct ImageVariant {
+        bool forceLinearSpace = false;
+        /// Limits the largest dimension of the image, 0 means full resolution.
+        /// Already loaded full resolution image is used for any limit
+        uint32_t maxResolution = 0;
+        /// Index of the channel extracted into a one-component image, -1 means all channels,
+        /// rpr::kImageChannelLuminance means luminance
+        int channel = -1;
+        /// Constant scale and bias baked into linearized pixels
+        GfVec4f scale = GfVec4f(1.0f);
+        GfVec4f bias = GfVec4f(0.0f);
+
+        bool IsBaked() const { return scale != GfVec4f(1.0f) || bias != GfVec4f(0.0f); }
+        bool IsConverted() const { return channel >= 0 || IsBaked(); }
+    };
 
-    std::shared_ptr<rpr::Image> GetImage(std::string const& path, bool forceLinearSpace = false);
+    std::shared_ptr<rpr::Image> GetImage(std::string const& path, ImageVariant const& variant = ImageVariant());
+
+    /// Returns the image if it's already loaded. Otherwise, starts decoding it on worker threads and returns nullptr.
+    /// Decoded images become available after CommitLoadedImages call.
+    /// Formats that can be loaded only by RPR itself are loaded synchronously
+    std::shared_ptr<rpr::Image> GetImageAsync(std::string const& path, ImageVariant const& variant = ImageVariant());
+    bool IsImageLoading(std::string const& path, ImageVariant const& variant = ImageVariant());
+    /// Returns the image only if it's already loaded
+    std::shared_ptr<rpr::Image> GetLoadedImage(std::string const& path, ImageVariant const& variant = ImageVariant());
+    /// Whether image variants with extracted channel or baked values can be loaded for the file
+    bool IsConversionSupported(std::string const& path);
+    /// Decodes the image variant without creating RPR image, the disk cache is used. Can be called from any thread
+    bool LoadImageData(std::string const& path, ImageVariant const& variant, rpr::ImageData* outData) const;
+
+    /// Returns the content of the IES profile file. Profiles are validated against their files
+    /// and are retained within the same memory budget as images
+    std::shared_ptr<std::string const> GetIesProfile(std::string const& path);
+
+    /// Creates RPR images from decoded data. To bound the number of render restarts, images are committed
+    /// only when all of them are decoded or when a limited number of intermediate commits is not exhausted yet.
+    /// Returns true if any image was committed
+    bool CommitLoadedImages();
+
+    /// Blocks until an image is decoded after the last CommitLoadedImages call, a throttled commit becomes due,
+    /// the timeout expires or WakeUp is called. Returns true if CommitLoadedImages would commit anything.
+    /// Can be called from any thread
+    bool WaitForLoadedImages(std::chrono::steady_clock::duration timeout);
+    /// Interrupts the current or the next WaitForLoadedImages call. Can be called from any thread
+    void WakeUp();
 
     void RequireGarbageCollection();
     void GarbageCollectIfNeeded();
 
     rpr::Context* GetContext() { return m_context; }
 
-private:
+    struct Stats {
+        size_t numHits = 0;
+        size_t numMisses = 0;
+        size_t numEvictions = 0;
+        /// Decoded size of images and IES profiles kept alive by the cache itself
+        size_t retainedMemoryUsage = 0;
+        size_t externalMemoryUsage = 0;
+    };
+    Stats const& GetStats() const { return m_stats; }
+
+    void SetMemoryBudget(size_t numBytes);
+    /// Memory used by decoded data that is kept outside of the cache, e.g. pixels of texture atlas pages.
+    /// It's counted against the memory budget, so that fewer images are retained
+    void SetExternalMemoryUsage(size_t numBytes);
+
     class ImageMetadata {
     public:
         ImageMetadata() = default;
@@ -48,18 +128,105 @@ private:
 
         bool IsMetadataEqual(ImageMetadata const& md);
 
+        size_t GetFileSize() const { return m_size; }
+        double GetModificationTime() const { return m_modificationTime; }
+
     public:
         std::weak_ptr<rpr::Image> handle;
+        /// Size of the decoded image in bytes
+        size_t memoryUsage = 0u;
+        bool isDownsampled = false;
+        /// Whether the image is the same for both variants of forceLinearSpace
+        bool isLinear = false;
+
+        std::string path;
+        /// Whether changes of the file are tracked by the file watcher, no validation required then
+        bool isWatched = false;
+        std::chrono::steady_clock::time_point validationTime;
 
     private:
         size_t m_size = 0u;
         double m_modificationTime = 0.0;
     };
 
+    /// Validates data that was decoded from md.path and is kept outside of the cache, md is captured
+    /// before the file was read. Files are checked according to HDRPR_IMAGE_CACHE_VALIDATION, except that
+    /// in watch mode they are checked periodically because changes are reported only for cached entries
+    bool IsFileUpToDate(ImageMetadata& md);
+
+private:
+    std::string GetCacheKey(std::string const& path, ImageVariant const& variant);
+    std::string GetDiskCacheKey(std::string const& path, ImageMetadata const& md, ImageVariant const& variant) const;
+
+    /// Loads decoded image from the disk cache or decodes the file. Can be called from any thread
+    bool LoadImageData(std::string const& path, ImageMetadata const& md, ImageVariant const& variant, rpr::ImageData* outData) const;
+    std::shared_ptr<rpr::Image> Find(std::string const& cacheKey);
+    bool IsUpToDate(ImageMetadata& md);
+    void ProcessFileChanges();
+    void Insert(std::string const& path, ImageVariant const& variant, ImageMetadata md, std::shared_ptr<rpr::Image> const& image);
+
+    void Retain(std::shared_ptr<void const> const& object, size_t memoryUsage);
+    void EvictIfNeeded();
+
 private:
     rpr::Context* m_context;
+    ImageDiskCache m_diskCache;
     std::unordered_map<std::string, ImageMetadata> m_cache;
+
+    struct IesProfile {
+        ImageMetadata md;
+        std::weak_ptr<std::string const> data;
+    };
+    std::unordered_map<std::string, IesProfile> m_iesProfiles;
+
+    enum ValidationMode {
+        kValidationStat,
+        kValidationWatch,
+        kValidationPeriodic
+    };
+    ValidationMode m_validationMode;
+    std::chrono::steady_clock::duration m_revalidationInterval;
+    FileWatcher m_fileWatcher;
+    std::unordered_set<std::string> m_changedFiles;
     bool m_garbageCollectionRequired = false;
+
+    struct RetainedObject {
+        std::shared_ptr<void const> object;
+        size_t memoryUsage;
+    };
+    using RetainedObjectList = std::list<RetainedObject>;
+    RetainedObjectList m_retainedObjects;
+    std::unordered_map<void const*, RetainedObjectList::iterator> m_retainedObjectIndex;
+    size_t m_memoryBudget;
+
+    Stats m_stats;
+
+    struct LoadingImage {
+        std::string path;
+        ImageVariant variant;
+        ImageMetadata md;
+        std::unique_ptr<rpr::ImageData> data;
+        bool isDecoded = false;
+        std::atomic<bool> isDone{false};
+    };
+    std::unordered_map<std::string, std::shared_ptr<LoadingImage>> m_loadingImages;
+    // Committed images are kept alive until the next commit so that materials can pick them up
+    std::vector<std::shared_ptr<rpr::Image>> m_committedImages;
+    int m_numIntermediateCommits = 0;
+    std::chrono::steady_clock::time_point m_lastCommitTime;
+    // Also runs disk cache writes queued by const LoadImageData
+    mutable WorkDispatcher m_loadDispatcher;
+
+    // Completion signal of the load dispatcher, all fields are guarded by m_loadSignalMutex
+    std::mutex m_loadSignalMutex;
+    std::condition_variable m_loadSignal;
+    size_t m_numDecodedImages = 0;
+    /// m_numDecodedImages at the start of the last CommitLoadedImages call
+    size_t m_numSeenDecodedImages = 0;
+    size_t m_numCommittedImages = 0;
+    /// When throttled images can be committed, time_point::max() if only the end of the loading wave can commit them
+    std::chrono::steady_clock::time_point m_nextCommitTime;
+    bool m_isWakeUpRequested = false;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,234 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+
+#include "imageDiskCache.h"
+#include "rpr/imageHelpers.h"
+
+#include "pxr/base/arch/defines.h"
+#include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/arch/systemInfo.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/fileUtils.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_DISK_CACHE, false,
+    "Store decoded textures in the hdRpr cache directory to speed up their loading in next sessions");
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_DISK_CACHE_SIZE_MB, 1024,
+    "Maximum size in megabytes of the texture disk cache, the oldest files are removed on startup to fit into it");
+
+namespace {
+
+const char kFileExtension[] = ".rprimage";
+const char kMagic[8] = {'H', 'D', 'R', 'P', 'R', 'I', 'M', 'G'};
+const uint32_t kVersion = 1;
+const size_t kDataAlignment = 64;
+const uint32_t kFlagDownsampled = 1 << 0;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t keyLength;
+    uint32_t componentType;
+    uint32_t numComponents;
+    uint32_t width;
+    uint32_t height;
+    float gamma;
+    uint32_t flags;
+    uint64_t dataSize;
+    uint64_t dataOffset;
+};
+
+size_t GetDataSize(rpr::ImageData const& data) {
+    size_t bytesPerComponent = 1;
+    if (data.format.type == RPR_COMPONENT_TYPE_FLOAT16) {
+        bytesPerComponent = 2;
+    } else if (data.format.type == RPR_COMPONENT_TYPE_FLOAT32) {
+        bytesPerComponent = 4;
+    }
+    return size_t(data.width) * data.height * data.format.num_components * bytesPerComponent;
+}
+
+} // namespace anonymous
+
+ImageDiskCache::ImageDiskCache(std::string const& directory) {
+    if (directory.empty() || !TfGetEnvSetting(HDRPR_TEXTURE_DISK_CACHE)) {
+        return;
+    }
+
+    if (!TfIsDir(directory) && !TfMakeDirs(directory, -1, true)) {
+        TF_RUNTIME_ERROR("Failed to create texture cache directory: %s", directory.c_str());
+        return;
+    }
+    m_directory = directory;
+
+    RemoveOldestFiles(size_t(std::max(TfGetEnvSetting(HDRPR_TEXTURE_DISK_CACHE_SIZE_MB), 0)) * 1024 * 1024);
+}
+
+std::string ImageDiskCache::GetFilePath(std::string const& key) const {
+    return TfStringPrintf("%s%c%016zx%s", m_directory.c_str(), ARCH_PATH_SEP[0], std::hash<std::string>()(key), kFileExtension);
+}
+
+bool ImageDiskCache::Load(std::string const& key, rpr::ImageData* outData) const {
+    if (!IsEnabled()) {
+        return false;
+    }
+
+    auto filePath = GetFilePath(key);
+    if (!TfIsFile(filePath)) {
+        return false;
+    }
+
+    auto mapping = ArchMapFileReadOnly(filePath);
+    if (!mapping) {
+        return false;
+    }
+
+    size_t fileSize = ArchGetFileMappingLength(mapping);
+    if (fileSize < sizeof(FileHeader)) {
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, mapping.get(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion ||
+        sizeof(FileHeader) + header.keyLength > fileSize ||
+        header.dataOffset + header.dataSize > fileSize ||
+        // Different keys might end up in the same file
+        key.compare(0, std::string::npos, mapping.get() + sizeof(FileHeader), header.keyLength) != 0) {
+        return false;
+    }
+
+    outData->format.type = header.componentType;
+    outData->format.num_components = header.numComponents;
+    outData->width = header.width;
+    outData->height = header.height;
+    outData->gamma = header.gamma;
+    outData->isDownsampled = (header.flags & kFlagDownsampled) != 0;
+    if (GetDataSize(*outData) != header.dataSize) {
+        return false;
+    }
+
+    outData->data = mapping.get() + header.dataOffset;
+    outData->dataOwner = std::shared_ptr<char const>(std::move(mapping));
+    return true;
+}
+
+void ImageDiskCache::Store(std::string const& key, rpr::ImageData const& data) const {
+    if (!IsEnabled() || !data.data) {
+        return;
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.keyLength = uint32_t(key.size());
+    header.componentType = data.format.type;
+    header.numComponents = data.format.num_components;
+    header.width = data.width;
+    header.height = data.height;
+    header.gamma = data.gamma;
+    header.flags = data.isDownsampled ? kFlagDownsampled : 0;
+    header.dataSize = GetDataSize(data);
+    header.dataOffset = (sizeof(FileHeader) + key.size() + kDataAlignment - 1) / kDataAlignment * kDataAlignment;
+
+    // Write into a temporary file first so that concurrent sessions never read partially written files.
+    // Temporary file name is unique across processes and threads sharing the cache directory
+    auto filePath = GetFilePath(key);
+    auto tmpFilePath = TfStringPrintf("%s.%d.%zx.tmp", filePath.c_str(), ArchGetProcessId(), std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream file(tmpFilePath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return;
+        }
+
+        static const char kPadding[kDataAlignment] = {};
+        file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(kPadding, header.dataOffset - sizeof(header) - key.size());
+        file.write(static_cast<char const*>(data.data), header.dataSize);
+        if (!file) {
+            file.close();
+            std::remove(tmpFilePath.c_str());
+            return;
+        }
+    }
+
+#if defined(ARCH_OS_WINDOWS)
+    // On Windows rename does not replace existing file
+    std::remove(filePath.c_str());
+#endif
+    // On POSIX rename atomically replaces the file, readers see either the old or the new one
+    if (std::rename(tmpFilePath.c_str(), filePath.c_str()) != 0) {
+        std::remove(tmpFilePath.c_str());
+    }
+}
+
+void ImageDiskCache::RemoveOldestFiles(size_t maxSize) {
+    std::vector<std::string> fileNames;
+    if (!TfReadDir(m_directory, nullptr, &fileNames, nullptr)) {
+        return;
+    }
+
+    struct CacheFile {
+        std::string path;
+        size_t size;
+        double modificationTime;
+    };
+    std::vector<CacheFile> files;
+    size_t totalSize = 0;
+    for (auto& fileName : fileNames) {
+        if (!TfStringEndsWith(fileName, kFileExtension)) {
+            continue;
+        }
+
+        CacheFile file;
+        file.path = m_directory + ARCH_PATH_SEP + fileName;
+        int64_t size = ArchGetFileLength(file.path.c_str());
+        if (size < 0 || !ArchGetModificationTime(file.path.c_str(), &file.modificationTime)) {
+            continue;
+        }
+        file.size = size_t(size);
+        totalSize += file.size;
+        files.push_back(std::move(file));
+    }
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(files.begin(), files.end(), [](CacheFile const& lhs, CacheFile const& rhs) {
+        return lhs.modificationTime < rhs.modificationTime;
+    });
+    for (auto& file : files) {
+        if (totalSize <= maxSize) {
+            break;
+        }
+        if (std::remove(file.path.c_str()) == 0) {
+            totalSize -= file.size;
+        }
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
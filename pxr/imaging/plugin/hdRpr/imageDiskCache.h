@@ -0,0 +1,50 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+
+#ifndef HDRPR_IMAGE_DISK_CACHE_H
+#define HDRPR_IMAGE_DISK_CACHE_H
+
+#include "pxr/pxr.h"
+
+#include <string>
+
+namespace rpr { struct ImageData; }
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Persistent cache of decoded images. Images are stored in the layout RPR expects,
+/// so loading is a memory mapping of the file that is passed directly to RPR.
+/// Load and Store can be called from multiple threads and processes
+class ImageDiskCache {
+public:
+    /// Empty directory disables the cache
+    ImageDiskCache(std::string const& directory);
+
+    bool IsEnabled() const { return !m_directory.empty(); }
+
+    /// Key should identify the source file state and all the conversions applied to it
+    bool Load(std::string const& key, rpr::ImageData* outData) const;
+    void Store(std::string const& key, rpr::ImageData const& data) const;
+
+private:
+    std::string GetFilePath(std::string const& key) const;
+    void RemoveOldestFiles(size_t maxSize);
+
+private:
+    std::string m_directory;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_IMAGE_DISK_CACHE_H
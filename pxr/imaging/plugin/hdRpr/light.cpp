@@ -23,14 +23,27 @@ limitations under the License.
 #include "pxr/usd/usdLux/tokens.h"
 #include "pxr/usd/sdf/assetPath.h"
 
-#include "pxr/usdImaging/usdImaging/implicitSurfaceMeshUtils.h"
-#include "pxr/imaging/pxOsd/meshTopology.h"
-
 PXR_NAMESPACE_OPEN_SCOPE
 
 namespace {
 
 TF_DEFINE_ENV_SETTING(HDRPR_VISIBLE_LIGHTS, false, "Make lights visible for primary rays");
+TF_DEFINE_ENV_SETTING(HDRPR_LIGHT_SIMPLIFICATION_SOLID_ANGLE, 0,
+    "Area lights that subtend a smaller solid angle (in microsteradians) from the camera are rendered as point or spot lights "
+    "in interactive mode and in reduced render qualities, 0 disables the simplification");
+
+/// Simplified light is restored only when its solid angle exceeds the threshold by this factor,
+/// so that lights close to the threshold do not switch back and forth while the camera moves
+constexpr float kSimplificationRestoreFactor = 1.5f;
+
+float GetSimplificationSolidAngle() {
+    static const float solidAngle = std::max(TfGetEnvSetting(HDRPR_LIGHT_SIMPLIFICATION_SOLID_ANGLE), 0) * 1e-6f;
+    return solidAngle;
+}
+
+GfVec3f GetAxis(GfMatrix4f const& transform, int axis) {
+    return GfVec3f(transform[axis][0], transform[axis][1], transform[axis][2]);
+}
 
 float GetDiskLightNormalization(GfMatrix4f const& transform, float radius) {
     const double sx = GfVec3d(transform[0][0], transform[1][0], transform[2][0]).GetLength() * radius;
@@ -118,73 +131,6 @@ float ComputeLightIntensity(float intensity, float exposure) {
 
 } // namespace anonymous
 
-rpr::Shape* HdRprLight::CreateDiskLightMesh(HdRprApi* rprApi) {
-    constexpr uint32_t kDiskVertexCount = 32;
-    constexpr float kRadius = 0.5f;
-
-    VtVec3fArray points;
-    VtIntArray pointIndices;
-    VtVec3fArray normals(1, GfVec3f(0.0f, 0.0f, -1.0f));
-    VtIntArray normalIndices(kDiskVertexCount * 3, 0);
-    VtIntArray vpf(kDiskVertexCount, 3);
-
-    points.reserve(kDiskVertexCount + 1);
-    pointIndices.reserve(kDiskVertexCount * 3);
-
-    const double step = M_PI * 2.0 / kDiskVertexCount;
-    for (int i = 0; i < kDiskVertexCount; ++i) {
-        double angle = step * i;
-        points.push_back(GfVec3f(kRadius * cos(angle), kRadius * sin(angle), 0.0f));
-    }
-    const int centerPointIndex = points.size();
-    points.push_back(GfVec3f(0.0f));
-
-    for (int i = 0; i < kDiskVertexCount; ++i) {
-        pointIndices.push_back(i);
-        pointIndices.push_back((i + 1) % kDiskVertexCount);
-        pointIndices.push_back(centerPointIndex);
-    }
-
-    return rprApi->CreateMesh(points, pointIndices, normals, normalIndices, VtVec2fArray(), VtIntArray(), vpf, HdTokens->rightHanded);
-}
-
-rpr::Shape* HdRprLight::CreateRectLightMesh(HdRprApi* rprApi, bool applyTransform, GfMatrix4f const& transform) {
-    constexpr float kHalfSize = 0.5f;
-    VtVec3fArray points = {
-        GfVec3f(kHalfSize, kHalfSize, 0.0f),
-        GfVec3f(kHalfSize, -kHalfSize, 0.0f),
-        GfVec3f(-kHalfSize, -kHalfSize, 0.0f),
-        GfVec3f(-kHalfSize, kHalfSize, 0.0f),
-    };
-    VtIntArray pointIndices = {
-        0, 1, 2,
-        0, 2, 3
-    };
-    VtIntArray vpf(pointIndices.size() / 3, 3);
-
-    if (applyTransform) {
-        for (auto& position : points) {
-            position = transform.Transform(position);
-        }
-    }
-
-    return rprApi->CreateMesh(points, pointIndices, VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), vpf, HdTokens->rightHanded);
-}
-
-rpr::Shape* HdRprLight::CreateSphereLightMesh(HdRprApi* rprApi) {
-    auto& topology = UsdImagingGetUnitSphereMeshTopology();
-    auto& points = UsdImagingGetUnitSphereMeshPoints();
-
-    return rprApi->CreateMesh(points, topology.GetFaceVertexIndices(), VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), topology.GetFaceVertexCounts(), topology.GetOrientation());
-}
-
-rpr::Shape* HdRprLight::CreateCylinderLightMesh(HdRprApi* rprApi) {
-    auto& topology = UsdImagingGetUnitCylinderMeshTopology();
-    auto& points = UsdImagingGetUnitCylinderMeshPoints();
-
-    return rprApi->CreateMesh(points, topology.GetFaceVertexIndices(), VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), topology.GetFaceVertexCounts(), topology.GetOrientation());
-}
-
 void HdRprLight::SyncAreaLightGeomParams(AreaLight* light, HdSceneDelegate* sceneDelegate, float* intensity) {
     bool normalizeIntensity = sceneDelegate->GetLightParamValue(GetId(), HdLightTokens->normalize).Get<bool>();
 
@@ -225,32 +171,30 @@ void HdRprLight::SyncAreaLightGeomParams(AreaLight* light, HdSceneDelegate* scen
 void HdRprLight::CreateAreaLightMesh(HdRprApi* rprApi) {
     auto light = new AreaLight;
 
+    auto addMesh = [light, rprApi](HdRprApi::UnitPrimitive primitive, GfMatrix4f const& transform) {
+        if (auto mesh = rprApi->CreateUnitPrimitiveInstance(primitive)) {
+            light->meshes.push_back(mesh);
+            light->meshTransforms.push_back(transform);
+        }
+    };
+
     if (rprApi->IsArbitraryShapedLightSupported()) {
-        rpr::Shape* mesh = nullptr;
         if (m_lightType == HdPrimTypeTokens->diskLight) {
-            mesh = CreateDiskLightMesh(rprApi);
+            addMesh(HdRprApi::kUnitDisk, GfMatrix4f(1.0f));
         } else if (m_lightType == HdPrimTypeTokens->rectLight) {
-            mesh = CreateRectLightMesh(rprApi);
+            addMesh(HdRprApi::kUnitRect, GfMatrix4f(1.0f));
         } else if (m_lightType == HdPrimTypeTokens->cylinderLight) {
-            mesh = CreateCylinderLightMesh(rprApi);
+            addMesh(HdRprApi::kUnitCylinder, GfMatrix4f(1.0f));
         } else if (m_lightType == HdPrimTypeTokens->sphereLight) {
-            mesh = CreateSphereLightMesh(rprApi);
-        }
-
-        if (mesh) {
-            light->meshes.push_back(mesh);
+            addMesh(HdRprApi::kUnitSphere, GfMatrix4f(1.0f));
         }
     } else {
         if (m_lightType == HdPrimTypeTokens->rectLight) {
-            if (auto mesh = CreateRectLightMesh(rprApi)) {
-                light->meshes.push_back(mesh);
-            }
+            addMesh(HdRprApi::kUnitRect, GfMatrix4f(1.0f));
         } else if (m_lightType == HdPrimTypeTokens->diskLight) {
             // Rescale rect so that total emission power equals to emission power of approximated shape (area equality)
             // pi*(R/2)^2 = a^2 -> a = R * sqrt(pi) / 2
-            if (auto mesh = CreateRectLightMesh(rprApi, true, GfMatrix4f(1.0f).SetScale(GfVec3f(sqrt(M_PI) / 2.0)))) {
-                light->meshes.push_back(mesh);
-            }
+            addMesh(HdRprApi::kUnitRect, GfMatrix4f(1.0f).SetScale(GfVec3f(sqrt(M_PI) / 2.0)));
         } else if (m_lightType == HdPrimTypeTokens->sphereLight ||
                    m_lightType == HdPrimTypeTokens->cylinderLight) {
             // Approximate sphere and cylinder lights via cube
@@ -276,9 +220,7 @@ void HdRprLight::CreateAreaLightMesh(HdRprApi* rprApi) {
             }
 
             for (auto& transform : sideTransforms) {
-                if (auto mesh = CreateRectLightMesh(rprApi, true, transform * scale)) {
-                    light->meshes.push_back(mesh);
-                }
+                addMesh(HdRprApi::kUnitRect, transform * scale);
             }
         }
     }
@@ -306,47 +248,78 @@ void HdRprLight::Sync(HdSceneDelegate* sceneDelegate,
     }
 
     if (bits & DirtyParams) {
-        ReleaseLight(rprApi);
-
         bool isVisible = sceneDelegate->GetVisible(id);
         if (!isVisible) {
             // Invisible light does not produces any emission on a scene.
             // So we simply keep light primitive empty in that case.
-            // We can do it in such a way because Hydra releases light object
-            // whenever it changed and creates it from scratch
+            ReleaseLight(rprApi);
+            rprRenderParam->RemoveSimplifiableLight(this);
             *dirtyBits = DirtyBits::Clean;
             return;
         }
 
-        auto iesFile = sceneDelegate->GetLightParamValue(id, UsdLuxTokens->shapingIesFile);
-        if (iesFile.IsHolding<SdfAssetPath>()) {
-            auto& path = iesFile.UncheckedGet<SdfAssetPath>();
-            if (!path.GetResolvedPath().empty()) {
-                if (auto light = rprApi->CreateIESLight(path.GetResolvedPath())) {
-                    m_light = light;
-                }
-            }
+        // Light is recreated only when its kind changes (e.g. IES profile is assigned),
+        // emission and size changes are applied to the existing light
+        LightType lightType = kLightTypeArea;
+        std::string iesFile;
+        float coneAngle = 0.0f;
+        float coneSoftness = 0.0f;
+
+        auto iesFileValue = sceneDelegate->GetLightParamValue(id, UsdLuxTokens->shapingIesFile);
+        if (iesFileValue.IsHolding<SdfAssetPath>()) {
+            lightType = kLightIES;
+            iesFile = iesFileValue.UncheckedGet<SdfAssetPath>().GetResolvedPath();
         } else {
-            auto coneAngle = sceneDelegate->GetLightParamValue(id, UsdLuxTokens->shapingConeAngle);
-            auto coneSoftness = sceneDelegate->GetLightParamValue(id, UsdLuxTokens->shapingConeSoftness);
-            if (coneAngle.IsHolding<float>() && coneSoftness.IsHolding<float>()) {
-                if (auto light = rprApi->CreateSpotLight(coneAngle.UncheckedGet<float>(), coneSoftness.UncheckedGet<float>())) {
+            auto coneAngleValue = sceneDelegate->GetLightParamValue(id, UsdLuxTokens->shapingConeAngle);
+            auto coneSoftnessValue = sceneDelegate->GetLightParamValue(id, UsdLuxTokens->shapingConeSoftness);
+            if (coneAngleValue.IsHolding<float>() && coneSoftnessValue.IsHolding<float>()) {
+                lightType = kLightTypeSpot;
+                coneAngle = coneAngleValue.UncheckedGet<float>();
+                coneSoftness = coneSoftnessValue.UncheckedGet<float>();
+            } else if (sceneDelegate->GetLightParamValue(id, UsdLuxTokens->treatAsPoint).GetWithDefault(false)) {
+                lightType = kLightTypePoint;
+            }
+        }
+
+        bool isNewLight = m_light.which() != lightType ||
+                          (lightType == kLightIES && iesFile != m_iesFile);
+        if (isNewLight) {
+            ReleaseLight(rprApi);
+
+            if (lightType == kLightIES) {
+                if (!iesFile.empty()) {
+                    if (auto light = rprApi->CreateIESLight(iesFile)) {
+                        m_light = light;
+                        m_iesFile = iesFile;
+                    }
+                }
+            } else if (lightType == kLightTypeSpot) {
+                if (auto light = rprApi->CreateSpotLight(coneAngle, coneSoftness)) {
                     m_light = light;
                 }
-            } else if (sceneDelegate->GetLightParamValue(id, UsdLuxTokens->treatAsPoint).GetWithDefault(false)) {
+            } else if (lightType == kLightTypePoint) {
                 if (auto light = rprApi->CreatePointLight()) {
                     m_light = light;
                 }
             } else {
                 CreateAreaLightMesh(rprApi);
             }
+        } else if (lightType == kLightTypeSpot) {
+            rprApi->SetSpotLightShape(BOOST_NS::get<rpr::SpotLight*>(m_light), coneAngle, coneSoftness);
         }
 
         if (m_light.which() == kLightTypeNone) {
+            rprRenderParam->RemoveSimplifiableLight(this);
             *dirtyBits = DirtyBits::Clean;
             return;
         }
 
+        if (m_light.which() == kLightTypeArea && GetSimplificationSolidAngle() > 0.0f) {
+            rprRenderParam->AddSimplifiableLight(this);
+        } else {
+            rprRenderParam->RemoveSimplifiableLight(this);
+        }
+
         float intensity = sceneDelegate->GetLightParamValue(id, HdLightTokens->intensity).Get<float>();
         float exposure = sceneDelegate->GetLightParamValue(id, HdLightTokens->exposure).Get<float>();
         intensity = ComputeLightIntensity(intensity, exposure);
@@ -364,7 +337,7 @@ void HdRprLight::Sync(HdSceneDelegate* sceneDelegate,
         }
 
         auto emissionColor = color * intensity;
-        bool isEmissionColorDirty = m_emisionColor != emissionColor;
+        bool isEmissionColorDirty = isNewLight || m_emisionColor != emissionColor;
         if (isEmissionColorDirty) { m_emisionColor = emissionColor; }
 
         struct LightParameterSetter : public BOOST_NS::static_visitor<bool> {
@@ -381,17 +354,27 @@ void HdRprLight::Sync(HdSceneDelegate* sceneDelegate,
             bool operator()(AreaLight* light) const {
                 if (emissionColorIsDirty || !light->material) {
                     MaterialAdapter matAdapter(EMaterialType::EMISSIVE, MaterialParams{{HdLightTokens->color, VtValue(emissionColor)}});
-                    light->material = std::move(rprApi->CreateMaterial(matAdapter));
-                }
 
-                if (light->material) {
-                    for (auto& mesh : light->meshes) {
-                        rprApi->SetMeshMaterial(mesh, light->material, false, false);
+                    // Materials are shared between lights with the same emission color,
+                    // the emission node is updated in place only when no other light uses the material
+                    if (light->material && rprApi->UpdateMaterial(light->material, matAdapter)) {
+                        return true;
+                    }
+
+                    auto oldMaterial = light->material;
+                    light->material = rprApi->CreateMaterial(matAdapter);
+
+                    if (light->material) {
+                        for (auto& mesh : light->meshes) {
+                            rprApi->SetMeshMaterial(mesh, light->material, false, false);
+                        }
+                    }
+                    if (oldMaterial) {
+                        rprApi->Release(oldMaterial);
                     }
-                    return true;
                 }
 
-                return false;
+                return light->material != nullptr;
             }
 
             bool operator()(rpr::SpotLight* light) const {
@@ -429,8 +412,8 @@ void HdRprLight::Sync(HdSceneDelegate* sceneDelegate,
             void operator()(LightVariantEmpty) const {}
             void operator()(AreaLight* light) const {
                 auto modelTransform = light->localTransform * transform;
-                for (auto& mesh : light->meshes) {
-                    rprApi->SetTransform(mesh, modelTransform);
+                for (size_t i = 0; i < light->meshes.size(); ++i) {
+                    rprApi->SetTransform(light->meshes[i], light->meshTransforms[i] * modelTransform);
                 }
             }
             void operator()(rpr::PointLight* light) const { rprApi->SetTransform(light, transform); }
@@ -438,11 +421,144 @@ void HdRprLight::Sync(HdSceneDelegate* sceneDelegate,
             void operator()(rpr::IESLight* light) const { rprApi->SetTransform(light, transform); }
         };
         BOOST_NS::apply_visitor(LightTransformSetter{rprApi, m_transform}, m_light);
+
+        if (IsSimplified()) {
+            SyncSimplifiedLight(rprApi, BOOST_NS::get<AreaLight*>(m_light));
+        }
     }
 
     *dirtyBits = DirtyBits::Clean;
 }
 
+bool HdRprLight::IsPlanarAreaLight() const {
+    return m_lightType == HdPrimTypeTokens->diskLight ||
+           m_lightType == HdPrimTypeTokens->rectLight;
+}
+
+bool HdRprLight::IsSimplified() const {
+    if (m_light.which() != kLightTypeArea) {
+        return false;
+    }
+
+    auto light = BOOST_NS::get<AreaLight*>(m_light);
+    return light->simplifiedPointLight || light->simplifiedSpotLight;
+}
+
+bool HdRprLight::IsSimplificationWanted(GfVec3f const& cameraPosition, bool isInteractive) const {
+    if (!isInteractive || m_light.which() != kLightTypeArea) {
+        return false;
+    }
+
+    auto light = BOOST_NS::get<AreaLight*>(m_light);
+    auto shapeTransform = light->localTransform * m_transform;
+
+    // Unit primitives fit into a sphere of diameter 1, the thickness of planar shapes does not matter
+    float boundingRadius = std::max(GetAxis(shapeTransform, 0).GetLength(), GetAxis(shapeTransform, 1).GetLength());
+    if (!IsPlanarAreaLight()) {
+        boundingRadius = std::max(boundingRadius, GetAxis(shapeTransform, 2).GetLength());
+    }
+    boundingRadius *= 0.5f;
+
+    float distance = (shapeTransform.ExtractTranslation() - cameraPosition).GetLength();
+    if (distance <= boundingRadius) {
+        return false;
+    }
+
+    float solidAngle = M_PI * boundingRadius * boundingRadius / (distance * distance);
+    float threshold = GetSimplificationSolidAngle();
+    if (IsSimplified()) {
+        threshold *= kSimplificationRestoreFactor;
+    }
+    return solidAngle < threshold;
+}
+
+void HdRprLight::SetSimplified(HdRprApi* rprApi, bool simplify) {
+    if (m_light.which() != kLightTypeArea || simplify == IsSimplified()) {
+        return;
+    }
+
+    auto light = BOOST_NS::get<AreaLight*>(m_light);
+    if (simplify) {
+        if (IsPlanarAreaLight()) {
+            // Planar lights emit into the hemisphere around -Z axis, the same as spot lights
+            light->simplifiedSpotLight = rprApi->CreateSpotLight(90.0f, 1.0f);
+        } else {
+            light->simplifiedPointLight = rprApi->CreatePointLight();
+        }
+        if (!IsSimplified()) {
+            return;
+        }
+
+        // Meshes are only hidden so that the light can be restored without rebuilding it
+        for (auto& mesh : light->meshes) {
+            rprApi->SetMeshVisibility(mesh, false);
+        }
+        SyncSimplifiedLight(rprApi, light);
+    } else {
+        ReleaseSimplifiedLight(rprApi, light);
+
+        for (auto& mesh : light->meshes) {
+            rprApi->SetMeshVisibility(mesh, true);
+            if (!TfGetEnvSetting(HDRPR_VISIBLE_LIGHTS)) {
+                rprApi->SetMeshLightVisibility(mesh, true);
+            }
+        }
+    }
+}
+
+void HdRprLight::SyncSimplifiedLight(HdRprApi* rprApi, AreaLight* light) {
+    auto shapeTransform = light->localTransform * m_transform;
+    float sx = GetAxis(shapeTransform, 0).GetLength();
+    float sy = GetAxis(shapeTransform, 1).GetLength();
+    float sz = GetAxis(shapeTransform, 2).GetLength();
+
+    float area = 0.0f;
+    if (m_lightType == HdPrimTypeTokens->diskLight) {
+        area = M_PI * 0.25f * sx * sy;
+    } else if (m_lightType == HdPrimTypeTokens->rectLight) {
+        area = sx * sy;
+    } else if (m_lightType == HdPrimTypeTokens->sphereLight) {
+        // Knud Thomsen approximation of the ellipsoid surface area
+        constexpr double p = 1.6075;
+        double ap = pow(sx * 0.5, p);
+        double bp = pow(sy * 0.5, p);
+        double cp = pow(sz * 0.5, p);
+        area = 4.0 * M_PI * pow((ap * bp + ap * cp + bp * cp) / 3.0, 1.0 / p);
+    } else if (m_lightType == HdPrimTypeTokens->cylinderLight) {
+        // Unit cylinder is aligned with Z axis
+        float a = sx * 0.5f;
+        float b = sy * 0.5f;
+        area = 2.0f * M_PI * a * b + M_PI * (a + b) * sz;
+    }
+
+    // Radiant intensity of a diffuse emitter is its radiance times its projected area.
+    // Planar lights are matched along their normal,
+    // closed shapes by the mean projected area that is a quarter of the surface area of a convex body
+    auto intensity = m_emisionColor * (IsPlanarAreaLight() ? area : area * 0.25f);
+
+    auto lightTransform = shapeTransform;
+    lightTransform.Orthonormalize(false);
+
+    if (light->simplifiedSpotLight) {
+        rprApi->SetLightColor(light->simplifiedSpotLight, intensity);
+        rprApi->SetTransform(light->simplifiedSpotLight, lightTransform);
+    } else if (light->simplifiedPointLight) {
+        rprApi->SetLightColor(light->simplifiedPointLight, intensity);
+        rprApi->SetTransform(light->simplifiedPointLight, lightTransform);
+    }
+}
+
+void HdRprLight::ReleaseSimplifiedLight(HdRprApi* rprApi, AreaLight* light) {
+    if (light->simplifiedSpotLight) {
+        rprApi->Release(light->simplifiedSpotLight);
+        light->simplifiedSpotLight = nullptr;
+    }
+    if (light->simplifiedPointLight) {
+        rprApi->Release(light->simplifiedPointLight);
+        light->simplifiedPointLight = nullptr;
+    }
+}
+
 
 HdDirtyBits HdRprLight::GetInitialDirtyBitsMask() const {
     return DirtyBits::DirtyTransform
@@ -461,6 +577,7 @@ void HdRprLight::ReleaseLight(HdRprApi* rprApi) {
         void operator()(rpr::IESLight* light) const { rprApi->Release(light); }
 
         void operator()(AreaLight* light) const {
+            HdRprLight::ReleaseSimplifiedLight(rprApi, light);
             for (auto& mesh : light->meshes) {
                 rprApi->Release(mesh);
             }
@@ -479,6 +596,7 @@ void HdRprLight::Finalize(HdRenderParam* renderParam) {
         m_created = false;
         rprRenderParam->RemoveLight();
     }
+    rprRenderParam->RemoveSimplifiableLight(this);
 
     auto rprApi = rprRenderParam->AcquireRprApiForEdit();
     ReleaseLight(rprApi);
@@ -21,6 +21,8 @@ limitations under the License.
 #include "boostIncludePath.h"
 #include BOOST_INCLUDE_PATH(variant.hpp)
 
+#include <string>
+
 namespace rpr { class Shape; class PointLight; class SpotLight; class IESLight; }
 
 PXR_NAMESPACE_OPEN_SCOPE
@@ -45,17 +47,21 @@ public:
 
     void Finalize(HdRenderParam* renderParam) override;
 
+    /// Whether the area light is substituted by an analytic light, see HDRPR_LIGHT_SIMPLIFICATION_SOLID_ANGLE
+    bool IsSimplified() const;
+    bool IsSimplificationWanted(GfVec3f const& cameraPosition, bool isInteractive) const;
+    void SetSimplified(HdRprApi* rprApi, bool simplify);
+
 private:
     void CreateIESLight(HdRprApi* rprApi, std::string const& path);
 
     void CreateAreaLightMesh(HdRprApi* rprApi);
-    rpr::Shape* CreateDiskLightMesh(HdRprApi* rprApi);
-    rpr::Shape* CreateRectLightMesh(HdRprApi* rprApi, bool applyTransform = false, GfMatrix4f const& transform = GfMatrix4f(1.0f));
-    rpr::Shape* CreateSphereLightMesh(HdRprApi* rprApi);
-    rpr::Shape* CreateCylinderLightMesh(HdRprApi* rprApi);
 
     struct AreaLight;
     void SyncAreaLightGeomParams(AreaLight* light, HdSceneDelegate* sceneDelegate, float* intensity);
+    void SyncSimplifiedLight(HdRprApi* rprApi, AreaLight* light);
+    static void ReleaseSimplifiedLight(HdRprApi* rprApi, AreaLight* light);
+    bool IsPlanarAreaLight() const;
 
     void ReleaseLight(HdRprApi* rprApi);
 
@@ -65,6 +71,11 @@ private:
     struct AreaLight {
         HdRprApiMaterial* material = nullptr;
         std::vector<rpr::Shape*> meshes;
+        // Transforms of unit primitive instances relative to the light shape
+        std::vector<GfMatrix4f> meshTransforms;
+        // Analytic light that substitutes the shape in interactive previews
+        rpr::PointLight* simplifiedPointLight = nullptr;
+        rpr::SpotLight* simplifiedSpotLight = nullptr;
         GfMatrix4f localTransform;
     };
 
@@ -78,6 +89,7 @@ private:
         kLightTypeArea
     };
     Light m_light;
+    std::string m_iesFile;
 
     GfVec3f m_emisionColor = GfVec3f(0.0f);
     GfMatrix4f m_transform;
@@ -19,6 +19,10 @@ limitations under the License.
 
 #include "pxr/usd/sdf/assetPath.h"
 
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 TF_DEFINE_PRIVATE_TOKENS(_tokens,
@@ -72,6 +76,153 @@ static bool GetMaterialNetwork(
     return false;
 }
 
+namespace {
+
+/// Content of material network that does not depend on node paths
+struct NetworkKey {
+    struct Node {
+        TfToken identifier;
+        std::map<TfToken, VtValue> parameters;
+
+        bool operator==(Node const& rhs) const {
+            return identifier == rhs.identifier && parameters == rhs.parameters;
+        }
+    };
+    struct Relationship {
+        int inputNode;
+        TfToken inputName;
+        int outputNode;
+        TfToken outputName;
+
+        bool operator==(Relationship const& rhs) const {
+            return inputNode == rhs.inputNode && inputName == rhs.inputName &&
+                outputNode == rhs.outputNode && outputName == rhs.outputName;
+        }
+    };
+    std::vector<Node> nodes;
+    std::vector<Relationship> relationships;
+    size_t hash = 0;
+
+    NetworkKey(HdMaterialNetwork const& surface, HdMaterialNetwork const& displacement) {
+        Append(surface);
+        Append(displacement);
+    }
+
+    bool operator==(NetworkKey const& rhs) const {
+        return hash == rhs.hash && nodes == rhs.nodes && relationships == rhs.relationships;
+    }
+
+    struct Hash {
+        size_t operator()(NetworkKey const& key) const { return key.hash; }
+    };
+
+private:
+    void Append(HdMaterialNetwork const& network) {
+        // Network separator
+        HashCombine(&hash, nodes.size());
+
+        std::map<SdfPath, int> nodeIndices;
+        for (auto& node : network.nodes) {
+            nodeIndices.emplace(node.path, int(nodes.size()));
+            nodes.push_back({node.identifier, node.parameters});
+
+            HashCombine(&hash, node.identifier.Hash());
+            for (auto& parameter : node.parameters) {
+                HashCombine(&hash, parameter.first.Hash());
+                HashCombine(&hash, parameter.second.GetHash());
+            }
+        }
+
+        auto getNodeIndex = [&nodeIndices](SdfPath const& path) {
+            auto it = nodeIndices.find(path);
+            return it == nodeIndices.end() ? -1 : it->second;
+        };
+        for (auto& relationship : network.relationships) {
+            relationships.push_back({getNodeIndex(relationship.inputId), relationship.inputName,
+                                     getNodeIndex(relationship.outputId), relationship.outputName});
+
+            auto& r = relationships.back();
+            HashCombine(&hash, size_t(r.inputNode));
+            HashCombine(&hash, r.inputName.Hash());
+            HashCombine(&hash, size_t(r.outputNode));
+            HashCombine(&hash, r.outputName.Hash());
+        }
+    }
+};
+
+/// Houdini principled shader networks of the same look copied per asset differ only by node paths,
+/// so translation results are shared between them
+std::shared_ptr<MaterialAdapter const> GetHoudiniPrincipledShaderAdapter(HdMaterialNetwork const& surface, HdMaterialNetwork const& displacement) {
+    static std::mutex s_mutex;
+    static std::unordered_map<NetworkKey, std::shared_ptr<MaterialAdapter const>, NetworkKey::Hash> s_adapters;
+    static const size_t kMaxCachedAdapters = 1024;
+
+    NetworkKey key(surface, displacement);
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_adapters.find(key);
+        if (it != s_adapters.end()) {
+            return it->second;
+        }
+    }
+
+    auto adapter = std::make_shared<MaterialAdapter const>(EMaterialType::HOUDINI_PRINCIPLED_SHADER, surface, displacement);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_adapters.size() >= kMaxCachedAdapters) {
+        s_adapters.clear();
+    }
+    s_adapters.emplace(std::move(key), adapter);
+    return adapter;
+}
+
+} // namespace anonymous
+
+/// Translation of material network to MaterialAdapter. It does not touch RPR,
+/// so translations of all dirty materials run in parallel and only creation
+/// of RPR nodes is serialized
+struct HdRprMaterial::Translation {
+    HdSceneDelegate* sceneDelegate;
+    HdRprRenderParam* renderParam;
+    VtValue materialResource;
+
+    std::once_flag translateOnce;
+    std::shared_ptr<MaterialAdapter const> adapter;
+
+    void Translate() {
+        auto& networkMap = materialResource.UncheckedGet<HdMaterialNetworkMap>();
+
+        EMaterialType surfaceType = EMaterialType::NONE;
+        HdMaterialNetwork const* surface = nullptr;
+
+        EMaterialType displacementType = EMaterialType::NONE;
+        HdMaterialNetwork const* displacement = nullptr;
+
+        if (GetMaterialNetwork(HdMaterialTerminalTokens->surface, sceneDelegate, networkMap, *renderParam, &surfaceType, &surface)) {
+            if (GetMaterialNetwork(HdMaterialTerminalTokens->displacement, sceneDelegate, networkMap, *renderParam, &displacementType, &displacement)) {
+                if (displacementType != surfaceType) {
+                    displacement = nullptr;
+                }
+            }
+
+            auto const& displacementNetwork = displacement ? *displacement : HdMaterialNetwork{};
+            if (surfaceType == EMaterialType::HOUDINI_PRINCIPLED_SHADER) {
+                adapter = GetHoudiniPrincipledShaderAdapter(*surface, displacementNetwork);
+            } else {
+                adapter = std::make_shared<MaterialAdapter const>(surfaceType, *surface, displacementNetwork);
+            }
+        } else {
+            TF_CODING_WARNING("Material type not supported");
+        }
+    }
+
+    void Wait() {
+        // Translates on the calling thread if the worker has not picked it up yet
+        std::call_once(translateOnce, &Translation::Translate, this);
+    }
+};
+
 HdRprMaterial::HdRprMaterial(SdfPath const& id) : HdMaterial(id) {
 
 }
@@ -81,31 +232,23 @@ void HdRprMaterial::Sync(HdSceneDelegate* sceneDelegate,
                          HdDirtyBits* dirtyBits) {
 
     auto rprRenderParam = static_cast<HdRprRenderParam*>(renderParam);
-    auto rprApi = rprRenderParam->AcquireRprApiForEdit();
+    rprRenderParam->AcquireRprApiForEdit();
 
     if (*dirtyBits & HdMaterial::DirtyResource) {
         VtValue vtMat = sceneDelegate->GetMaterialResource(GetId());
         if (vtMat.IsHolding<HdMaterialNetworkMap>()) {
-            auto& networkMap = vtMat.UncheckedGet<HdMaterialNetworkMap>();
+            auto translation = std::make_shared<Translation>();
+            translation->sceneDelegate = sceneDelegate;
+            translation->renderParam = rprRenderParam;
+            translation->materialResource = std::move(vtMat);
 
-            EMaterialType surfaceType = EMaterialType::NONE;
-            HdMaterialNetwork const* surface = nullptr;
+            rprRenderParam->GetMaterialTranslationDispatcher().Run([translation]() {
+                translation->Wait();
+            });
 
-            EMaterialType displacementType = EMaterialType::NONE;
-            HdMaterialNetwork const* displacement = nullptr;
-
-            if (GetMaterialNetwork(HdMaterialTerminalTokens->surface, sceneDelegate, networkMap, *rprRenderParam, &surfaceType, &surface)) {
-                if (GetMaterialNetwork(HdMaterialTerminalTokens->displacement, sceneDelegate, networkMap, *rprRenderParam, &displacementType, &displacement)) {
-                    if (displacementType != surfaceType) {
-                        displacement = nullptr;
-                    }
-                }
-
-                MaterialAdapter matAdapter(surfaceType, *surface, displacement ? *displacement : HdMaterialNetwork{});
-                m_rprMaterial = rprApi->CreateMaterial(matAdapter);
-            } else {
-                TF_CODING_WARNING("Material type not supported");
-            }
+            std::lock_guard<std::mutex> lock(m_commitMutex);
+            m_pendingTranslation = std::move(translation);
+            rprRenderParam->AddMaterialToCommit(this);
         }
     }
 
@@ -121,13 +264,35 @@ void HdRprMaterial::Reload() {
 }
 
 void HdRprMaterial::Finalize(HdRenderParam* renderParam) {
-    static_cast<HdRprRenderParam*>(renderParam)->AcquireRprApiForEdit()->Release(m_rprMaterial);
+    auto rprRenderParam = static_cast<HdRprRenderParam*>(renderParam);
+    rprRenderParam->RemoveMaterialToCommit(this);
+
+    std::lock_guard<std::mutex> lock(m_commitMutex);
+    m_pendingTranslation = nullptr;
+
+    rprRenderParam->AcquireRprApiForEdit()->Release(m_rprMaterial);
     m_rprMaterial = nullptr;
 
     HdMaterial::Finalize(renderParam);
 }
 
 HdRprApiMaterial const* HdRprMaterial::GetRprMaterialObject() const {
+    std::lock_guard<std::mutex> lock(m_commitMutex);
+    if (m_pendingTranslation) {
+        auto translation = std::move(m_pendingTranslation);
+        translation->Wait();
+
+        if (auto& matAdapter = translation->adapter) {
+            auto rprApi = translation->renderParam->AcquireRprApiForEdit();
+
+            // Parameter-only changes are applied to the existing node graph
+            if (!rprApi->UpdateMaterial(m_rprMaterial, *matAdapter)) {
+                translation->renderParam->ReleaseMaterialAfterCommit(m_rprMaterial);
+                m_rprMaterial = rprApi->CreateMaterial(*matAdapter);
+            }
+        }
+    }
+
     return m_rprMaterial;
 }
 
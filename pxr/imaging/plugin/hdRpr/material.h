@@ -16,6 +16,9 @@ limitations under the License.
 
 #include "pxr/imaging/hd/material.h"
 
+#include <mutex>
+#include <memory>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 struct HdRprApiMaterial;
@@ -36,11 +39,17 @@ public:
     void Finalize(HdRenderParam* renderParam) override;
 
     /// Get pointer to RPR material
-    /// In case material сreation failure return nullptr
+    /// In case material сreation failure return nullptr.
+    /// Creates RPR material from the network translated after the last Sync if it's not created yet
     HdRprApiMaterial const* GetRprMaterialObject() const;
 
 private:
-    HdRprApiMaterial* m_rprMaterial = nullptr;
+    struct Translation;
+
+    /// Guards commit of the translation, rprims that use the material are synced in parallel
+    mutable std::mutex m_commitMutex;
+    mutable std::shared_ptr<Translation> m_pendingTranslation;
+    mutable HdRprApiMaterial* m_rprMaterial = nullptr;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
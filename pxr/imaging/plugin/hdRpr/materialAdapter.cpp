@@ -38,6 +38,117 @@ TF_DEFINE_PRIVATE_TOKENS(HdRprTextureChannelToken,
     (a)
 );
 
+namespace {
+
+/// Resolves texture path. Paths of UDIM sets keep the <UDIM> tag, the directory is resolved by the first found tile
+std::string ResolveTexturePath(SdfAssetPath const& assetPath) {
+    if (!assetPath.GetResolvedPath().empty()) {
+        return assetPath.GetResolvedPath();
+    }
+
+    auto& path = assetPath.GetAssetPath();
+    auto tagPos = path.find(kUdimTag);
+    if (tagPos == std::string::npos) {
+        return ArGetResolver().Resolve(path);
+    }
+
+    static const size_t kUdimTagLength = sizeof(kUdimTag) - 1;
+    auto suffix = path.substr(tagPos + kUdimTagLength);
+    for (int tile = 1001; tile <= 1100; ++tile) {
+        auto tileString = std::to_string(tile);
+        auto tilePath = path;
+        tilePath.replace(tagPos, kUdimTagLength, tileString);
+
+        auto resolvedPath = ArGetResolver().Resolve(tilePath);
+        if (resolvedPath.empty()) {
+            continue;
+        }
+
+        // Resolver may change the path around the file name (e.g. package paths end with ']'),
+        // so the substituted tile number is looked up by the part of the path that follows it
+        auto tilePos = resolvedPath.rfind(tileString);
+        for (auto pos = tilePos; pos != std::string::npos; pos = pos ? resolvedPath.rfind(tileString, pos - 1) : std::string::npos) {
+            if (resolvedPath.compare(pos + tileString.size(), suffix.size(), suffix) == 0) {
+                tilePos = pos;
+                break;
+            }
+        }
+        if (tilePos == std::string::npos) {
+            TF_RUNTIME_ERROR("Failed to find UDIM tile number in resolved path: %s", resolvedPath.c_str());
+            return std::string();
+        }
+
+        resolvedPath.replace(tilePos, tileString.size(), kUdimTag);
+        return resolvedPath;
+    }
+
+    return std::string();
+}
+
+} // namespace anonymous
+
+bool operator==(MaterialTexture const& lhs, MaterialTexture const& rhs) {
+    return lhs.path == rhs.path &&
+        lhs.channel == rhs.channel &&
+        lhs.wrapMode == rhs.wrapMode &&
+        lhs.scale == rhs.scale &&
+        lhs.bias == rhs.bias &&
+        lhs.uvTransform == rhs.uvTransform &&
+        lhs.forceLinearSpace == rhs.forceLinearSpace;
+}
+
+size_t hash_value(MaterialTexture const& texture) {
+    size_t hash = std::hash<std::string>()(texture.path);
+    HashCombine(&hash, size_t(texture.channel));
+    HashCombine(&hash, size_t(texture.wrapMode));
+    HashCombine(&hash, hash_value(texture.scale));
+    HashCombine(&hash, hash_value(texture.bias));
+    HashCombine(&hash, hash_value(texture.uvTransform));
+    HashCombine(&hash, size_t(texture.forceLinearSpace));
+    return hash;
+}
+
+bool operator==(NormalMapParam const& lhs, NormalMapParam const& rhs) {
+    return lhs.texture == rhs.texture &&
+        lhs.effectScale == rhs.effectScale;
+}
+
+size_t MaterialAdapter::GetHash() const {
+    size_t hash = size_t(m_type);
+    for (auto& param : m_vec4fRprParams) {
+        HashCombine(&hash, size_t(param.first));
+        HashCombine(&hash, hash_value(param.second));
+    }
+    for (auto& param : m_uRprParams) {
+        HashCombine(&hash, size_t(param.first));
+        HashCombine(&hash, size_t(param.second));
+    }
+    for (auto& param : m_texRpr) {
+        HashCombine(&hash, size_t(param.first));
+        HashCombine(&hash, hash_value(param.second));
+    }
+    for (auto& param : m_normalMapParams) {
+        for (auto input : param.first) {
+            HashCombine(&hash, size_t(input));
+        }
+        HashCombine(&hash, hash_value(param.second.texture));
+        HashCombine(&hash, std::hash<float>()(param.second.effectScale));
+    }
+    HashCombine(&hash, hash_value(m_displacementTexture));
+    HashCombine(&hash, size_t(m_doublesided));
+    return hash;
+}
+
+bool MaterialAdapter::operator==(MaterialAdapter const& rhs) const {
+    return m_type == rhs.m_type &&
+        m_vec4fRprParams == rhs.m_vec4fRprParams &&
+        m_uRprParams == rhs.m_uRprParams &&
+        m_texRpr == rhs.m_texRpr &&
+        m_normalMapParams == rhs.m_normalMapParams &&
+        m_displacementTexture == rhs.m_displacementTexture &&
+        m_doublesided == rhs.m_doublesided;
+}
+
 GfVec4f VtValToVec4f(const VtValue val) {
     if (val.IsHolding<int>()) {
         return GfVec4f(val.Get<int>());
@@ -216,11 +327,7 @@ void GetTextures(const  HdMaterialNetwork& materialNetwork, MaterialTextures& ou
         // Get image path
         if (param.IsHolding<SdfAssetPath>()) {
             auto& assetPath = param.UncheckedGet<SdfAssetPath>();
-            if (assetPath.GetResolvedPath().empty()) {
-                materialNode.path = ArGetResolver().Resolve(assetPath.GetAssetPath());
-            } else {
-                materialNode.path = assetPath.GetResolvedPath();
-            }
+            materialNode.path = ResolveTexturePath(assetPath);
         } else {
             continue;
         }
@@ -611,7 +718,7 @@ void MaterialAdapter::PopulateHoudiniPrincipledShader(HdMaterialNetwork const& s
                 if (*texturePropertyName == '\0') {
                     if (it->second.IsHolding<SdfAssetPath>()) {
                         auto& assetPath = it->second.UncheckedGet<SdfAssetPath>();
-                        texture.path = assetPath.GetResolvedPath();
+                        texture.path = ResolveTexturePath(assetPath);
                     }
                 } else if (std::strcmp(texturePropertyName, "Intensity") == 0) {
                     if (it->second.IsHolding<float>()) {
@@ -876,8 +983,9 @@ void MaterialAdapter::PopulateHoudiniPrincipledShader(HdMaterialNetwork const& s
                 TF_RUNTIME_ERROR("Vector displacement unsupported");
             } else {
                 auto dispTexturePath = GetParameter<SdfAssetPath>(HoudiniPrincipledShaderTokens->displacementTexture, dispParams);
-                if (!dispTexturePath.GetResolvedPath().empty()) {
-                    m_displacementTexture.path = dispTexturePath.GetResolvedPath();
+                auto resolvedDispTexturePath = ResolveTexturePath(dispTexturePath);
+                if (!resolvedDispTexturePath.empty()) {
+                    m_displacementTexture.path = resolvedDispTexturePath;
                     m_displacementTexture.scale = GfVec4f(GetParameter(HoudiniPrincipledShaderTokens->displacementScale, dispParams, 0.05f));
                     m_displacementTexture.bias = GfVec4f(GetParameter(HoudiniPrincipledShaderTokens->displacementOffset, dispParams, -0.5f));
                     m_displacementTexture.wrapMode = HoudiniWrapModeToRpr(GetParameter<std::string>(HoudiniPrincipledShaderTokens->displacementWrap, dispParams));
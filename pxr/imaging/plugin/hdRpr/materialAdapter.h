@@ -77,7 +77,11 @@ enum class EColorChannel {
     , LUMINANCE
 };
 
+/// Tag in the texture path that is replaced by the tile number for UDIM texture sets
+constexpr char kUdimTag[] = "<UDIM>";
+
 struct MaterialTexture {
+    /// Resolved path, UDIM sets have kUdimTag in place of the tile number
     std::string path;
 
     EColorChannel channel = EColorChannel::NONE;
@@ -92,6 +96,14 @@ struct MaterialTexture {
     bool forceLinearSpace = false;
 };
 
+bool operator==(MaterialTexture const& lhs, MaterialTexture const& rhs);
+size_t hash_value(MaterialTexture const& texture);
+
+/// Mixes hash into seed, the same way as boost::hash_combine
+inline void HashCombine(size_t* seed, size_t hash) {
+    *seed ^= hash + 0x9e3779b9 + (*seed << 6) + (*seed >> 2);
+}
+
 typedef std::map<TfToken, VtValue> MaterialParams;
 typedef std::map<TfToken, MaterialTexture> MaterialTextures;
 
@@ -103,6 +115,8 @@ struct NormalMapParam {
     MaterialTexture texture;
     float effectScale = 1.0f;
 };
+
+bool operator==(NormalMapParam const& lhs, NormalMapParam const& rhs);
 using MaterialRprParamsNormalMap = std::vector<std::pair<std::vector<rpr::MaterialNodeInput>, NormalMapParam>>;
 
 enum class EMaterialType : int32_t {
@@ -148,6 +162,10 @@ public:
         return m_doublesided;
     }
 
+    /// Adapters that are equal produce identical RPR material graphs
+    size_t GetHash() const;
+    bool operator==(MaterialAdapter const& rhs) const;
+
 private:
     void PopulateRprColor(const MaterialParams& params);
     void PopulateEmissive(const MaterialParams& params);
@@ -13,15 +13,67 @@ limitations under the License.
 
 #include "materialFactory.h"
 #include "imageCache.h"
+#include "imageAtlas.h"
+#include "debugCodes.h"
 
 #include "rpr/error.h"
+#include "rpr/imageHelpers.h"
+
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/fileUtils.h"
 
 #include <RadeonProRender.hpp>
 
+#include <algorithm>
+#include <tuple>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
+TF_DEFINE_ENV_SETTING(HDRPR_ASYNC_TEXTURE_LOADING, true,
+    "Decode textures in background, materials use placeholder textures until then");
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_BAKE_CONSTANTS, false,
+    "Bake constant scale, bias and luminance conversion of textures into pixels instead of evaluating them per sample");
+
 namespace {
 
+template <typename Map>
+bool HasSameKeys(Map const& lhs, Map const& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (auto lhsIt = lhs.begin(), rhsIt = rhs.begin(); lhsIt != lhs.end(); ++lhsIt, ++rhsIt) {
+        if (lhsIt->first != rhsIt->first) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsAsyncTextureLoadingEnabled() {
+    static const bool asyncTextureLoading = TfGetEnvSetting(HDRPR_ASYNC_TEXTURE_LOADING);
+    return asyncTextureLoading;
+}
+
+bool IsTextureBakingEnabled() {
+    static const bool textureBaking = TfGetEnvSetting(HDRPR_TEXTURE_BAKE_CONSTANTS);
+    return textureBaking;
+}
+
+/// Whether lhs resolution limit allows larger images than rhs, 0 means no limit
+bool IsHigherResolution(uint32_t lhs, uint32_t rhs) {
+    return rhs != 0 && (lhs == 0 || lhs > rhs);
+}
+
+bool IsUdimPath(std::string const& path) {
+    return path.find(kUdimTag) != std::string::npos;
+}
+
+std::string GetUdimTilePath(std::string const& path, uint32_t tile) {
+    auto tilePath = path;
+    tilePath.replace(tilePath.find(kUdimTag), sizeof(kUdimTag) - 1, std::to_string(tile));
+    return tilePath;
+}
+
 bool GfIsEqual(GfVec4f const& v1, GfVec4f const& v2, float tolerance = 1e-5f) {
     return std::abs(v1[0] - v2[0]) <= tolerance &&
            std::abs(v1[1] - v2[1]) <= tolerance &&
@@ -60,6 +112,127 @@ bool GetWrapType(const EWrapMode& wrapMode, rpr_image_wrap_type& rprWrapType) {
     return false;
 }
 
+int GetChannelIndex(EColorChannel colorChannel) {
+    switch (colorChannel) {
+        case EColorChannel::R:
+            return 0;
+        case EColorChannel::G:
+            return 1;
+        case EColorChannel::B:
+            return 2;
+        case EColorChannel::A:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+/// UDIM tiles covered by faces, the tile of a face is determined by its UV centroid
+std::vector<uint32_t> GetUdimTiles(VtVec2fArray const& uvs, VtIntArray const& uvIndexes, VtIntArray const& vpf) {
+    std::vector<uint32_t> tiles;
+    if (uvs.empty() || uvIndexes.empty()) {
+        return tiles;
+    }
+
+    size_t indicesOffset = 0;
+    uint32_t prevTile = 0;
+    for (auto numVerticesPerFace : vpf) {
+        if (indicesOffset + numVerticesPerFace > uvIndexes.size()) {
+            break;
+        }
+
+        GfVec2f centroid(0.0f);
+        for (int i = 0; i < numVerticesPerFace; ++i) {
+            auto uvIndex = uvIndexes[indicesOffset + i];
+            if (uvIndex >= 0 && size_t(uvIndex) < uvs.size()) {
+                centroid += uvs[uvIndex];
+            }
+        }
+        indicesOffset += numVerticesPerFace;
+        centroid /= float(std::max(numVerticesPerFace, 1));
+
+        if (centroid[0] < 0.0f || centroid[0] >= 10.0f || centroid[1] < 0.0f || centroid[1] >= 100.0f) {
+            continue;
+        }
+        uint32_t tile = 1001 + uint32_t(centroid[0]) + 10 * uint32_t(centroid[1]);
+        if (tile != prevTile) {
+            tiles.push_back(tile);
+            prevTile = tile;
+        }
+    }
+
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+    return tiles;
+}
+
+void AddMissingUdimTile(HdRprApiMaterial::UdimTextureNode* udimTexture, uint32_t tile, std::string const& tilePath) {
+    ImageCache::ImageMetadata md(tilePath);
+    md.path = tilePath;
+    md.validationTime = std::chrono::steady_clock::now();
+    udimTexture->missingTiles[tile] = std::move(md);
+}
+
+ImageCache::ImageVariant GetImageVariant(ImageCache* imageCache, MaterialTexture const& texture, uint32_t maxResolution) {
+    ImageCache::ImageVariant variant;
+    variant.forceLinearSpace = texture.forceLinearSpace;
+    variant.maxResolution = maxResolution;
+
+    int channel = GetChannelIndex(texture.channel);
+    bool isBakingEnabled = IsTextureBakingEnabled();
+    if ((channel < 0 && !isBakingEnabled) || !imageCache->IsConversionSupported(texture.path)) {
+        return variant;
+    }
+
+    // Texture that is sampled only for a single channel is loaded as a one-component image
+    // that takes less memory and does not need channel selection node
+    variant.channel = channel;
+    if (isBakingEnabled) {
+        variant.scale = texture.scale;
+        variant.bias = texture.bias;
+        if (texture.channel == EColorChannel::LUMINANCE) {
+            variant.channel = rpr::kImageChannelLuminance;
+        }
+    }
+    return variant;
+}
+
+/// Value of the input while its texture is loading: the material's constant value if there is one,
+/// otherwise a value that does not add light or transparency
+GfVec4f GetPlaceholderValue(EMaterialType type, rpr::MaterialNodeInput input, MaterialAdapter const& materialAdapter) {
+    auto& constants = materialAdapter.GetVec4fRprParams();
+    auto constantIt = constants.find(input);
+    if (constantIt != constants.end()) {
+        return constantIt->second;
+    }
+
+    if (type == EMaterialType::EMISSIVE && input == RPR_MATERIAL_INPUT_COLOR) {
+        return GfVec4f(0.0f);
+    }
+    switch (input) {
+        case RPR_MATERIAL_INPUT_UBER_EMISSION_COLOR:
+        case RPR_MATERIAL_INPUT_UBER_TRANSPARENCY:
+        case RPR_MATERIAL_INPUT_UBER_REFRACTION_WEIGHT:
+            return GfVec4f(0.0f);
+        case RPR_MATERIAL_INPUT_UBER_DIFFUSE_WEIGHT:
+            return GfVec4f(1.0f);
+        default:
+            // Mid gray
+            return GfVec4f(0.5f);
+    }
+}
+
+/// Pixel of the placeholder image that results in the value after scale and bias of the texture node
+GfVec4f GetPlaceholderPixel(GfVec4f const& value, GfVec4f const& scale, GfVec4f const& bias) {
+    GfVec4f pixel(0.0f);
+    for (int i = 0; i < 4; ++i) {
+        if (scale[i] != 0.0f) {
+            pixel[i] = (value[i] - bias[i]) / scale[i];
+        }
+    }
+    return pixel;
+}
+
 bool GetSelectedChannel(const EColorChannel& colorChannel, rpr_int& out_selectedChannel) {
     switch (colorChannel) {
         case EColorChannel::R:
@@ -83,11 +256,49 @@ bool GetSelectedChannel(const EColorChannel& colorChannel, rpr_int& out_selected
 } // namespace anonymous
 
 RprMaterialFactory::RprMaterialFactory(ImageCache* imageCache)
-    : m_imageCache(imageCache) {
+    : m_imageCache(imageCache)
+    , m_atlas(ImageAtlas::Create(imageCache)) {
+
+}
+
+RprMaterialFactory::~RprMaterialFactory() = default;
+
+void RprMaterialFactory::UpdatePendingTexturesState() {
+    m_hasPendingTextures = !m_materialsWithPendingTextures.empty() ||
+        !m_materialsWithDirtyUdimTiles.empty() ||
+        (m_atlas && m_atlas->HasUncommittedPages());
+}
 
+size_t RprMaterialFactory::GetMaterialHash(EMaterialType type, MaterialAdapter const& materialAdapter) {
+    size_t hash = materialAdapter.GetHash();
+    HashCombine(&hash, size_t(type));
+    return hash;
 }
 
 HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const MaterialAdapter& materialAdapter) {
+    size_t hash = GetMaterialHash(type, materialAdapter);
+
+    auto range = m_sharedMaterials.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto& sharedMaterial = it->second;
+        if (sharedMaterial.type == type && sharedMaterial.adapter == materialAdapter) {
+            sharedMaterial.refCount++;
+            m_numDeduplicatedMaterials++;
+            TF_DEBUG(HD_RPR_DEBUG_MATERIAL_CACHE).Msg("Material cache: %zu unique materials, %zu deduplicated\n",
+                m_sharedMaterialHashes.size(), m_numDeduplicatedMaterials);
+            return sharedMaterial.material;
+        }
+    }
+
+    auto material = CreateMaterialGraph(type, materialAdapter);
+    if (material) {
+        m_sharedMaterials.emplace(hash, SharedMaterial{type, materialAdapter, material, 1});
+        m_sharedMaterialHashes.emplace(material, hash);
+    }
+    return material;
+}
+
+HdRprApiMaterial* RprMaterialFactory::CreateMaterialGraph(EMaterialType type, const MaterialAdapter& materialAdapter) {
     rpr::MaterialNodeType materialType;
 
     switch (type) {
@@ -144,20 +355,64 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         RPR_ERROR_CHECK(material->rootMaterial->SetInput(paramId, paramValue), "Failed to set material node uint input");
     }
 
-    auto getTextureMaterialNode = [&material](ImageCache* imageCache, MaterialTexture const& matTex) -> rpr::MaterialNode* {
+    // placeholderValue is the value the texture node outputs until the texture is loaded
+    auto getTextureMaterialNode = [&material, this](ImageCache* imageCache, MaterialTexture const& matTex, GfVec4f const& placeholderValue, std::vector<rpr::MaterialNodeInput> const& rootInputs) -> rpr::MaterialNode* {
         if (matTex.path.empty()) {
             return nullptr;
         }
 
-        auto image = imageCache->GetImage(matTex.path, matTex.forceLinearSpace);
+        auto variant = GetImageVariant(imageCache, matTex, m_textureMaxResolution);
+
+        // One-component image is replicated to all components, so the selected component of scale and bias is used
+        auto scale = matTex.scale;
+        auto bias = matTex.bias;
+        if (variant.IsBaked() || variant.channel == rpr::kImageChannelLuminance) {
+            // Already applied to the image
+            scale = GfVec4f(1.0f);
+            bias = GfVec4f(0.0f);
+        } else if (variant.channel >= 0) {
+            scale = GfVec4f(matTex.scale[variant.channel]);
+            bias = GfVec4f(matTex.bias[variant.channel]);
+        }
+        auto placeholderPixel = GetPlaceholderPixel(placeholderValue, scale, bias);
+
+        bool isPending = false;
+        bool isUdim = IsUdimPath(matTex.path);
+        bool isAtlas = false;
+        ImageAtlas::Region atlasRegion;
+        std::shared_ptr<rpr::Image> image;
+        if (isUdim) {
+            // Tiles are loaded once meshes the material is attached to are known
+            image = GetPlaceholderImage(placeholderPixel);
+        } else if (m_atlas && matTex.wrapMode == EWrapMode::CLAMP && m_atlas->Add(matTex.path, variant, &atlasRegion)) {
+            // Page image is bound when the page is committed
+            isAtlas = true;
+            image = atlasRegion.isCommitted ? m_atlas->GetPageImage(atlasRegion.page) : nullptr;
+            if (!image) {
+                image = GetPlaceholderImage(placeholderPixel);
+            }
+        } else {
+            image = GetTextureImage(matTex, m_textureMaxResolution, &isPending);
+            if (isPending) {
+                image = GetPlaceholderImage(placeholderPixel);
+            }
+        }
         if (!image) {
             return nullptr;
         }
         auto rprImage = image.get();
-        material->materialImages.push_back(std::move(image));
+        std::shared_ptr<rpr::Image> atlasPageImage;
+        if (isAtlas) {
+            // Kept by the atlas texture node, so that it can be released when the page is recreated
+            if (atlasRegion.isCommitted) {
+                atlasPageImage = std::move(image);
+            }
+        } else {
+            material->materialImages.push_back(std::move(image));
+        }
 
         rpr::ImageWrapType rprWrapType;
-        if (GetWrapType(matTex.wrapMode, rprWrapType)) {
+        if (!isPending && !isUdim && !isAtlas && GetWrapType(matTex.wrapMode, rprWrapType)) {
             RPR_ERROR_CHECK(rprImage->SetWrap(rprWrapType), "Failed to set image wrap mode");
         }
 
@@ -173,52 +428,84 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         RPR_ERROR_CHECK(materialNode->SetInput(RPR_MATERIAL_INPUT_DATA, rprImage), "Failed to set material node image data input");
         material->materialNodes.push_back(materialNode);
 
-        if (!GfIsEqual(matTex.uvTransform, GfMatrix3f(1.0f))) {
-            rpr::MaterialNode* uvLookupNode = context->CreateMaterialNode(RPR_MATERIAL_NODE_INPUT_LOOKUP, &status);
+        if (isAtlas) {
+            material->atlasTextures.push_back({materialNode, atlasRegion.page, std::move(atlasPageImage)});
+            m_atlasPageMaterials[atlasRegion.page].insert(material);
+        } else if (isUdim) {
+            HdRprApiMaterial::UdimTextureNode udimTexture;
+            udimTexture.imageNode = materialNode;
+            udimTexture.texture = matTex;
+            udimTexture.maxResolution = m_textureMaxResolution;
+            material->udimTextures.push_back(std::move(udimTexture));
+        } else if (isPending) {
+            material->pendingTextures.push_back({materialNode, rprImage, matTex, m_textureMaxResolution, rootInputs});
+        } else if (m_textureMaxResolution) {
+            material->reducedTextures.push_back({materialNode, rprImage, matTex, m_textureMaxResolution});
+        }
+
+        // Atlas region is addressed after the texture's own transform. UVs are clamped to [0, 1] before that,
+        // so that sampling outside of the texture does not reach neighbouring regions of the page
+        bool hasUvTransform = !GfIsEqual(matTex.uvTransform, GfMatrix3f(1.0f));
+        if (hasUvTransform || isAtlas) {
+            // UV transform nodes depend only on constants, so they are shared between all materials
+            rpr::MaterialNode* uvLookupNode = AcquireSharedNode(material, RPR_MATERIAL_NODE_INPUT_LOOKUP, {
+                {RPR_MATERIAL_INPUT_VALUE, uint32_t(RPR_MATERIAL_NODE_LOOKUP_UV)}
+            });
+
+            // XXX (RPR): due to missing functionality to set explicitly third component of UV vector to 1
+            // third component set to 1 using addition
+            rpr::MaterialNode* uvNode = nullptr;
             if (uvLookupNode) {
-                RPR_ERROR_CHECK(uvLookupNode->SetInput(RPR_MATERIAL_INPUT_VALUE, rpr_uint(RPR_MATERIAL_NODE_LOOKUP_UV)), "Failed to set material node uint input");
-
-                rpr::MaterialNode* transformUvNode = context->CreateMaterialNode(RPR_MATERIAL_NODE_ARITHMETIC, &status);
-                if (transformUvNode) {
-                    // XXX (RPR): due to missing functionality to set explicitly third component of UV vector to 1
-                    // third component set to 1 using addition
-                    rpr::MaterialNode* setZtoOneNode = context->CreateMaterialNode(RPR_MATERIAL_NODE_ARITHMETIC, &status);
-                    if (setZtoOneNode) {
-                        RPR_ERROR_CHECK(setZtoOneNode->SetInput(RPR_MATERIAL_INPUT_OP, rpr_uint(RPR_MATERIAL_NODE_OP_ADD)), "Failed to set material node uint input");
-                        RPR_ERROR_CHECK(setZtoOneNode->SetInput(RPR_MATERIAL_INPUT_COLOR0, 0.0f, 0.0f, 1.0f, 0.0f), "Failed to set material node vec4 input");
-                        RPR_ERROR_CHECK(setZtoOneNode->SetInput(RPR_MATERIAL_INPUT_COLOR1, uvLookupNode), "Failed to set material node node input");
-
-                        RPR_ERROR_CHECK(transformUvNode->SetInput(RPR_MATERIAL_INPUT_OP, RPR_MATERIAL_NODE_OP_MAT_MUL), "Failed to set material node uint input");
-                        RPR_ERROR_CHECK(transformUvNode->SetInput(RPR_MATERIAL_INPUT_COLOR0, matTex.uvTransform[0][0], matTex.uvTransform[0][1], matTex.uvTransform[0][2], 0.0f), "Failed to set material node vec4 input");
-                        RPR_ERROR_CHECK(transformUvNode->SetInput(RPR_MATERIAL_INPUT_COLOR1, matTex.uvTransform[1][0], matTex.uvTransform[1][1], matTex.uvTransform[1][2], 0.0f), "Failed to set material node vec4 input");
-                        RPR_ERROR_CHECK(transformUvNode->SetInput(RPR_MATERIAL_INPUT_COLOR2, matTex.uvTransform[2][0], matTex.uvTransform[2][1], matTex.uvTransform[2][2], 0.0f), "Failed to set material node vec4 input");
-                        RPR_ERROR_CHECK(transformUvNode->SetInput(RPR_MATERIAL_INPUT_COLOR3, setZtoOneNode), "Failed to set material node node input");
-
-                        RPR_ERROR_CHECK(materialNode->SetInput(RPR_MATERIAL_INPUT_UV, transformUvNode), "Failed to set material node node input");
-
-                        material->materialNodes.push_back(transformUvNode);
-                        material->materialNodes.push_back(setZtoOneNode);
-                        material->materialNodes.push_back(uvLookupNode);
-                    } else {
-                        RPR_ERROR_CHECK(status, "Failed to create arithmetic material node");
-                        delete uvLookupNode;
-                        delete transformUvNode;
-                    }
-                } else {
-                    RPR_ERROR_CHECK(status, "Failed to create arithmetic material node");
-                    delete uvLookupNode;
+                uvNode = AcquireSharedNode(material, RPR_MATERIAL_NODE_ARITHMETIC, {
+                    {RPR_MATERIAL_INPUT_OP, uint32_t(RPR_MATERIAL_NODE_OP_ADD)},
+                    {RPR_MATERIAL_INPUT_COLOR0, GfVec4f(0.0f, 0.0f, 1.0f, 0.0f)},
+                    {RPR_MATERIAL_INPUT_COLOR1, uvLookupNode}
+                });
+            }
+
+            auto transformUv = [this, &material](rpr::MaterialNode* uvNode, GfMatrix3f const& m) {
+                return AcquireSharedNode(material, RPR_MATERIAL_NODE_ARITHMETIC, {
+                    {RPR_MATERIAL_INPUT_OP, uint32_t(RPR_MATERIAL_NODE_OP_MAT_MUL)},
+                    {RPR_MATERIAL_INPUT_COLOR0, GfVec4f(m[0][0], m[0][1], m[0][2], 0.0f)},
+                    {RPR_MATERIAL_INPUT_COLOR1, GfVec4f(m[1][0], m[1][1], m[1][2], 0.0f)},
+                    {RPR_MATERIAL_INPUT_COLOR2, GfVec4f(m[2][0], m[2][1], m[2][2], 0.0f)},
+                    {RPR_MATERIAL_INPUT_COLOR3, uvNode}
+                });
+            };
+
+            if (uvNode && hasUvTransform) {
+                uvNode = transformUv(uvNode, matTex.uvTransform);
+            }
+            if (uvNode && isAtlas) {
+                // Third component stays 1 after clamping
+                uvNode = AcquireSharedNode(material, RPR_MATERIAL_NODE_ARITHMETIC, {
+                    {RPR_MATERIAL_INPUT_OP, uint32_t(RPR_MATERIAL_NODE_OP_MAX)},
+                    {RPR_MATERIAL_INPUT_COLOR0, uvNode},
+                    {RPR_MATERIAL_INPUT_COLOR1, GfVec4f(0.0f)}
+                });
+                if (uvNode) {
+                    uvNode = AcquireSharedNode(material, RPR_MATERIAL_NODE_ARITHMETIC, {
+                        {RPR_MATERIAL_INPUT_OP, uint32_t(RPR_MATERIAL_NODE_OP_MIN)},
+                        {RPR_MATERIAL_INPUT_COLOR0, uvNode},
+                        {RPR_MATERIAL_INPUT_COLOR1, GfVec4f(1.0f)}
+                    });
+                }
+                if (uvNode) {
+                    uvNode = transformUv(uvNode, atlasRegion.uvTransform);
                 }
-            } else {
-                RPR_ERROR_CHECK(status, "Failed to create uv lookup material node");
+            }
+
+            if (uvNode) {
+                RPR_ERROR_CHECK(materialNode->SetInput(RPR_MATERIAL_INPUT_UV, uvNode), "Failed to set material node node input");
             }
         }
 
-        if (!GfIsEqual(matTex.scale, GfVec4f(1.0f))) {
+        if (!GfIsEqual(scale, GfVec4f(1.0f))) {
             rpr::MaterialNode* arithmetic = context->CreateMaterialNode(RPR_MATERIAL_NODE_ARITHMETIC, &status);
             if (arithmetic) {
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_OP, RPR_MATERIAL_NODE_OP_MUL), "Failed to set material node uint input");
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR0, materialNode), "Failed to set material node node input");
-                RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR1, matTex.scale[0], matTex.scale[1], matTex.scale[2], matTex.scale[3]), "Failed to set material node vec4 input");
+                RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR1, scale[0], scale[1], scale[2], scale[3]), "Failed to set material node vec4 input");
                 material->materialNodes.push_back(arithmetic);
 
                 materialNode = arithmetic;
@@ -227,12 +514,12 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
             }
         }
 
-        if (!GfIsEqual(matTex.bias, GfVec4f(0.0f))) {
+        if (!GfIsEqual(bias, GfVec4f(0.0f))) {
             rpr::MaterialNode* arithmetic = context->CreateMaterialNode(RPR_MATERIAL_NODE_ARITHMETIC, &status);
             if (arithmetic) {
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_OP, rpr_uint(RPR_MATERIAL_NODE_OP_ADD)), "Failed to set material node uint input");
                 RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR0, materialNode), "Failed to set material node node input");
-                RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR1, matTex.bias[0], matTex.bias[1], matTex.bias[2], matTex.bias[3]), "Failed to set material node vec4 input");
+                RPR_ERROR_CHECK(arithmetic->SetInput(RPR_MATERIAL_INPUT_COLOR1, bias[0], bias[1], bias[2], bias[3]), "Failed to set material node vec4 input");
                 material->materialNodes.push_back(arithmetic);
 
                 materialNode = arithmetic;
@@ -243,7 +530,9 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         }
 
         rpr::MaterialNode* outTexture = nullptr;
-        if (matTex.channel != EColorChannel::NONE) {
+        if (variant.channel >= 0) {
+            outTexture = materialNode;
+        } else if (matTex.channel != EColorChannel::NONE) {
             rpr_int selectedChannel = 0;
 
             if (GetSelectedChannel(matTex.channel, selectedChannel)) {
@@ -286,7 +575,8 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         auto& paramId = texParam.first;
         auto& matTex = texParam.second;
 
-        auto outNode = getTextureMaterialNode(m_imageCache, matTex);
+        auto placeholderValue = GetPlaceholderValue(type, paramId, materialAdapter);
+        auto outNode = getTextureMaterialNode(m_imageCache, matTex, placeholderValue, {paramId});
         if (!outNode) {
             continue;
         }
@@ -299,7 +589,12 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
     }
 
     for (auto const& normalMapParam : materialAdapter.GetNormalMapParams()) {
-        auto textureNode = getTextureMaterialNode(m_imageCache, normalMapParam.second.texture);
+        material->normalMapNodes.push_back(nullptr);
+
+        // Texel of a flat normal after the texture's scale and bias
+        auto& normalTexture = normalMapParam.second.texture;
+        auto flatNormal = GfCompMult(normalTexture.scale, GfVec4f(0.5f, 0.5f, 1.0f, 1.0f)) + normalTexture.bias;
+        auto textureNode = getTextureMaterialNode(m_imageCache, normalTexture, flatNormal, normalMapParam.first);
         if (!textureNode) {
             continue;
         }
@@ -307,6 +602,7 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         auto normalMapNode = context->CreateMaterialNode(RPR_MATERIAL_NODE_NORMAL_MAP, &status);
         if (normalMapNode) {
             material->materialNodes.push_back(normalMapNode);
+            material->normalMapNodes.back() = normalMapNode;
             RPR_ERROR_CHECK(normalMapNode->SetInput(RPR_MATERIAL_INPUT_COLOR, textureNode), "Failed to set material node node input");
 
             auto s = normalMapParam.second.effectScale;
@@ -345,29 +641,423 @@ HdRprApiMaterial* RprMaterialFactory::CreateMaterial(EMaterialType type, const M
         }
     }
 
-    material->displacementMaterial = getTextureMaterialNode(m_imageCache, materialAdapter.GetDisplacementTexture());
+    // Zero displacement placeholder is kept if the texture fails to load, it's equivalent to no displacement
+    material->displacementMaterial = getTextureMaterialNode(m_imageCache, materialAdapter.GetDisplacementTexture(), GfVec4f(0.0f), {});
+
+    if (!material->pendingTextures.empty()) {
+        m_materialsWithPendingTextures.insert(material);
+    }
+    if (!material->reducedTextures.empty()) {
+        m_materialsWithReducedTextures.insert(material);
+    }
+    if (!material->udimTextures.empty()) {
+        m_materialsWithUdimTextures.insert(material);
+    }
+    UpdatePendingTexturesState();
 
     return material;
 }
 
+std::shared_ptr<rpr::Image> RprMaterialFactory::GetTextureImage(MaterialTexture const& texture, uint32_t maxResolution, bool* isLoading) {
+    *isLoading = false;
+    auto variant = GetImageVariant(m_imageCache, texture, maxResolution);
+    if (!IsAsyncTextureLoadingEnabled()) {
+        return m_imageCache->GetImage(texture.path, variant);
+    }
+
+    auto image = m_imageCache->GetImageAsync(texture.path, variant);
+    if (!image) {
+        *isLoading = m_imageCache->IsImageLoading(texture.path, variant);
+    }
+    return image;
+}
+
+void RprMaterialFactory::BindTextureImage(HdRprApiMaterial* material, HdRprApiMaterial::TextureNode textureNode, std::shared_ptr<rpr::Image> image) {
+    textureNode.rootInputs.clear();
+    if (image.get() != textureNode.image) {
+        rpr::ImageWrapType rprWrapType;
+        if (GetWrapType(textureNode.texture.wrapMode, rprWrapType)) {
+            RPR_ERROR_CHECK(image->SetWrap(rprWrapType), "Failed to set image wrap mode");
+        }
+
+        RPR_ERROR_CHECK(textureNode.imageNode->SetInput(RPR_MATERIAL_INPUT_DATA, image.get()), "Failed to set material node image data input");
+
+        // Release previously bound image
+        auto& images = material->materialImages;
+        auto it = std::find_if(images.begin(), images.end(), [&textureNode](std::shared_ptr<rpr::Image> const& image) {
+            return image.get() == textureNode.image;
+        });
+        textureNode.image = image.get();
+        if (it != images.end()) {
+            *it = std::move(image);
+        } else {
+            images.push_back(std::move(image));
+        }
+        m_imageCache->RequireGarbageCollection();
+    }
+
+    if (textureNode.maxResolution) {
+        material->reducedTextures.push_back(std::move(textureNode));
+        m_materialsWithReducedTextures.insert(material);
+    }
+}
+
+bool RprMaterialFactory::SetTextureMaxResolution(uint32_t maxResolution) {
+    if (m_textureMaxResolution == maxResolution) {
+        return false;
+    }
+
+    bool isResolutionRaised = IsHigherResolution(maxResolution, m_textureMaxResolution);
+    m_textureMaxResolution = maxResolution;
+    if (!isResolutionRaised) {
+        // Already loaded textures are kept as is, new materials use the lower limit
+        return false;
+    }
+
+    bool isAnyTextureChanged = false;
+    for (auto material : m_materialsWithUdimTextures) {
+        for (auto& udimTexture : material->udimTextures) {
+            if (IsHigherResolution(maxResolution, udimTexture.maxResolution)) {
+                // Tiles are reloaded on the next commit
+                udimTexture.maxResolution = maxResolution;
+                udimTexture.isStale = true;
+                m_materialsWithDirtyUdimTiles.insert(material);
+            }
+        }
+    }
+
+    for (auto it = m_materialsWithReducedTextures.begin(); it != m_materialsWithReducedTextures.end();) {
+        auto material = *it;
+
+        std::vector<HdRprApiMaterial::TextureNode> reducedTextures;
+        std::swap(reducedTextures, material->reducedTextures);
+        for (auto& textureNode : reducedTextures) {
+            if (!IsHigherResolution(maxResolution, textureNode.maxResolution)) {
+                material->reducedTextures.push_back(std::move(textureNode));
+                continue;
+            }
+            textureNode.maxResolution = maxResolution;
+
+            bool isLoading;
+            auto image = GetTextureImage(textureNode.texture, maxResolution, &isLoading);
+            if (image) {
+                isAnyTextureChanged |= image.get() != textureNode.image;
+                BindTextureImage(material, std::move(textureNode), std::move(image));
+            } else if (isLoading) {
+                // Lower resolution image stays bound until the texture is loaded
+                material->pendingTextures.push_back(std::move(textureNode));
+                m_materialsWithPendingTextures.insert(material);
+            }
+            // Otherwise, the texture failed to load in higher resolution and lower resolution image stays
+        }
+
+        if (material->reducedTextures.empty()) {
+            it = m_materialsWithReducedTextures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    UpdatePendingTexturesState();
+
+    return isAnyTextureChanged;
+}
+
+std::shared_ptr<rpr::Image> RprMaterialFactory::GetPlaceholderImage(GfVec4f const& pixel) {
+    auto key = std::make_tuple(pixel[0], pixel[1], pixel[2], pixel[3]);
+    auto& weakPlaceholder = m_placeholderImages[key];
+    if (auto placeholder = weakPlaceholder.lock()) {
+        return placeholder;
+    }
+
+    rpr::ImageFormat format = {};
+    format.num_components = 4;
+    format.type = RPR_COMPONENT_TYPE_FLOAT32;
+
+    rpr::Status status;
+    std::shared_ptr<rpr::Image> placeholder(rpr::CreateImage(m_imageCache->GetContext(), 1, 1, format, pixel.data(), &status));
+    if (!placeholder) {
+        RPR_ERROR_CHECK(status, "Failed to create placeholder image");
+        m_placeholderImages.erase(key);
+        return nullptr;
+    }
+    weakPlaceholder = placeholder;
+
+    for (auto it = m_placeholderImages.begin(); it != m_placeholderImages.end();) {
+        if (it->second.expired()) {
+            it = m_placeholderImages.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return placeholder;
+}
+
+bool RprMaterialFactory::CommitLoadedTextures() {
+    bool isAnyTextureCommitted = CommitAtlasPages();
+    bool isAnyImageCommitted = m_imageCache->CommitLoadedImages();
+
+    for (auto it = m_materialsWithDirtyUdimTiles.begin(); it != m_materialsWithDirtyUdimTiles.end();) {
+        bool isLoading = false;
+        isAnyTextureCommitted |= UpdateUdimTextures(*it, &isLoading);
+        if (isLoading) {
+            ++it;
+        } else {
+            it = m_materialsWithDirtyUdimTiles.erase(it);
+        }
+    }
+
+    if (!isAnyImageCommitted) {
+        UpdatePendingTexturesState();
+        return isAnyTextureCommitted;
+    }
+
+    for (auto it = m_materialsWithPendingTextures.begin(); it != m_materialsWithPendingTextures.end();) {
+        auto material = *it;
+        auto& pendingTextures = material->pendingTextures;
+
+        for (size_t i = 0; i < pendingTextures.size();) {
+            auto& textureNode = pendingTextures[i];
+            auto variant = GetImageVariant(m_imageCache, textureNode.texture, textureNode.maxResolution);
+            if (m_imageCache->IsImageLoading(textureNode.texture.path, variant)) {
+                ++i;
+                continue;
+            }
+
+            if (auto image = m_imageCache->GetLoadedImage(textureNode.texture.path, variant)) {
+                BindTextureImage(material, textureNode, std::move(image));
+                isAnyTextureCommitted = true;
+            } else if (!textureNode.rootInputs.empty()) {
+                // Failed to load, inputs are left unset the same way as with synchronous loading
+                for (auto input : textureNode.rootInputs) {
+                    RPR_ERROR_CHECK(material->rootMaterial->SetInput(input, static_cast<rpr::MaterialNode*>(nullptr)), "Failed to unset material node input");
+                }
+                isAnyTextureCommitted = true;
+            }
+            // Otherwise, lower resolution image stays
+
+            pendingTextures[i] = std::move(pendingTextures.back());
+            pendingTextures.pop_back();
+        }
+
+        if (pendingTextures.empty()) {
+            it = m_materialsWithPendingTextures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    UpdatePendingTexturesState();
+
+    return isAnyTextureCommitted;
+}
+
 void RprMaterialFactory::Release(HdRprApiMaterial* material) {
     if (!material) {
         return;
     }
 
+    auto hashIt = m_sharedMaterialHashes.find(material);
+    if (hashIt != m_sharedMaterialHashes.end()) {
+        auto range = m_sharedMaterials.equal_range(hashIt->second);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.material == material) {
+                if (--it->second.refCount > 0) {
+                    return;
+                }
+                m_sharedMaterials.erase(it);
+                break;
+            }
+        }
+        m_sharedMaterialHashes.erase(hashIt);
+    }
+
+    ReleaseMaterialGraph(material);
+}
+
+bool RprMaterialFactory::UpdateMaterial(HdRprApiMaterial* material, EMaterialType type, MaterialAdapter const& materialAdapter) {
+    auto hashIt = m_sharedMaterialHashes.find(material);
+    if (hashIt == m_sharedMaterialHashes.end()) {
+        return false;
+    }
+
+    auto range = m_sharedMaterials.equal_range(hashIt->second);
+    auto sharedIt = std::find_if(range.first, range.second, [material](std::pair<const size_t, SharedMaterial> const& entry) {
+        return entry.second.material == material;
+    });
+    if (sharedIt == range.second || sharedIt->second.refCount > 1) {
+        return false;
+    }
+
+    auto& oldAdapter = sharedIt->second.adapter;
+    if (sharedIt->second.type != type || oldAdapter.IsDoublesided() != materialAdapter.IsDoublesided() ||
+        oldAdapter.GetTexRprParams() != materialAdapter.GetTexRprParams() ||
+        !(oldAdapter.GetDisplacementTexture() == materialAdapter.GetDisplacementTexture())) {
+        return false;
+    }
+
+    if (!HasSameKeys(oldAdapter.GetVec4fRprParams(), materialAdapter.GetVec4fRprParams()) ||
+        !HasSameKeys(oldAdapter.GetURprParams(), materialAdapter.GetURprParams())) {
+        return false;
+    }
+
+    auto& oldNormalMaps = oldAdapter.GetNormalMapParams();
+    auto& newNormalMaps = materialAdapter.GetNormalMapParams();
+    if (oldNormalMaps.size() != newNormalMaps.size() || material->normalMapNodes.size() != newNormalMaps.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < newNormalMaps.size(); ++i) {
+        if (oldNormalMaps[i].first != newNormalMaps[i].first ||
+            !(oldNormalMaps[i].second.texture == newNormalMaps[i].second.texture)) {
+            return false;
+        }
+    }
+
+    // Prefer sharing with an identical material over keeping a separate copy
+    size_t hash = GetMaterialHash(type, materialAdapter);
+    auto newRange = m_sharedMaterials.equal_range(hash);
+    for (auto it = newRange.first; it != newRange.second; ++it) {
+        if (it->second.material != material && it->second.type == type && it->second.adapter == materialAdapter) {
+            return false;
+        }
+    }
+
+    // The topology is the same, only parameter values are set
+    for (auto const& param : materialAdapter.GetVec4fRprParams()) {
+        if (materialAdapter.GetTexRprParams().count(param.first)) {
+            continue;
+        }
+        auto& value = param.second;
+        if (value != oldAdapter.GetVec4fRprParams().at(param.first)) {
+            RPR_ERROR_CHECK(material->rootMaterial->SetInput(param.first, value[0], value[1], value[2], value[3]), "Failed to set material node vec4 input");
+        }
+    }
+    for (auto const& param : materialAdapter.GetURprParams()) {
+        if (param.second != oldAdapter.GetURprParams().at(param.first)) {
+            RPR_ERROR_CHECK(material->rootMaterial->SetInput(param.first, param.second), "Failed to set material node uint input");
+        }
+    }
+    for (size_t i = 0; i < newNormalMaps.size(); ++i) {
+        auto normalMapNode = material->normalMapNodes[i];
+        auto s = newNormalMaps[i].second.effectScale;
+        if (normalMapNode && s != oldNormalMaps[i].second.effectScale) {
+            RPR_ERROR_CHECK(normalMapNode->SetInput(RPR_MATERIAL_INPUT_SCALE, s, s, s, s), "Failed to set material node node input");
+        }
+    }
+
+    auto sharedMaterial = std::move(sharedIt->second);
+    sharedMaterial.adapter = materialAdapter;
+    m_sharedMaterials.erase(sharedIt);
+    m_sharedMaterials.emplace(hash, std::move(sharedMaterial));
+    hashIt->second = hash;
+
+    return true;
+}
+
+void RprMaterialFactory::ReleaseMaterialGraph(HdRprApiMaterial* material) {
     if (!material->materialImages.empty()) {
         m_imageCache->RequireGarbageCollection();
     }
+    m_materialsWithPendingTextures.erase(material);
+    m_materialsWithReducedTextures.erase(material);
+    for (auto& atlasTexture : material->atlasTextures) {
+        auto it = m_atlasPageMaterials.find(atlasTexture.page);
+        if (it != m_atlasPageMaterials.end()) {
+            it->second.erase(material);
+            if (it->second.empty()) {
+                m_atlasPageMaterials.erase(it);
+                m_atlas->ReleasePage(atlasTexture.page);
+            }
+        }
+    }
+    if (!material->udimTextures.empty()) {
+        m_materialsWithUdimTextures.erase(material);
+        m_materialsWithDirtyUdimTiles.erase(material);
+        for (auto it = m_meshUdimMaterials.begin(); it != m_meshUdimMaterials.end();) {
+            if (it->second == material) {
+                it = m_meshUdimMaterials.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        m_imageCache->RequireGarbageCollection();
+    }
+    UpdatePendingTexturesState();
 
     delete material->rootMaterial;
     delete material->twosidedNode;
     for (auto node : material->materialNodes) {
         delete node;
     }
+    for (auto node : material->sharedNodes) {
+        ReleaseSharedNode(node);
+    }
     delete material;
 }
 
+bool RprMaterialFactory::SharedNodeInput::operator<(SharedNodeInput const& rhs) const {
+    return std::tie(input, isUint, uintValue, node, value[0], value[1], value[2], value[3]) <
+        std::tie(rhs.input, rhs.isUint, rhs.uintValue, rhs.node, rhs.value[0], rhs.value[1], rhs.value[2], rhs.value[3]);
+}
+
+rpr::MaterialNode* RprMaterialFactory::AcquireSharedNode(HdRprApiMaterial* material, rpr::MaterialNodeType type, std::vector<SharedNodeInput> inputs) {
+    std::sort(inputs.begin(), inputs.end());
+    SharedNodeKey key(type, std::move(inputs));
+
+    auto it = m_sharedNodes.find(key);
+    if (it == m_sharedNodes.end()) {
+        rpr::Status status;
+        auto node = m_imageCache->GetContext()->CreateMaterialNode(type, &status);
+        if (!node) {
+            RPR_ERROR_CHECK(status, "Failed to create material node");
+            return nullptr;
+        }
+
+        for (auto& input : key.second) {
+            if (input.isUint) {
+                RPR_ERROR_CHECK(node->SetInput(input.input, rpr_uint(input.uintValue)), "Failed to set material node uint input");
+            } else if (input.node) {
+                RPR_ERROR_CHECK(node->SetInput(input.input, input.node), "Failed to set material node node input");
+                // Pooled input stays alive while this node references it
+                m_sharedNodeKeys.at(input.node)->second.refCount++;
+            } else {
+                auto& v = input.value;
+                RPR_ERROR_CHECK(node->SetInput(input.input, v[0], v[1], v[2], v[3]), "Failed to set material node vec4 input");
+            }
+        }
+
+        it = m_sharedNodes.emplace(std::move(key), SharedNode{node, 0}).first;
+        m_sharedNodeKeys.emplace(node, it);
+    }
+
+    it->second.refCount++;
+    material->sharedNodes.push_back(it->second.node);
+    return it->second.node;
+}
+
+void RprMaterialFactory::ReleaseSharedNode(rpr::MaterialNode* node) {
+    auto keyIt = m_sharedNodeKeys.find(node);
+    if (keyIt == m_sharedNodeKeys.end()) {
+        return;
+    }
+
+    auto it = keyIt->second;
+    if (--it->second.refCount > 0) {
+        return;
+    }
+
+    m_sharedNodeKeys.erase(keyIt);
+    delete node;
+    for (auto& input : it->first.second) {
+        if (input.node) {
+            ReleaseSharedNode(input.node);
+        }
+    }
+    m_sharedNodes.erase(it);
+}
+
 void RprMaterialFactory::AttachMaterial(rpr::Shape* mesh, HdRprApiMaterial const* material, bool doublesided, bool displacementEnabled) {
+    // Factory owns materials, const is only for users of the material
+    SetMeshUdimMaterial(mesh, const_cast<HdRprApiMaterial*>(material));
+
     if (material) {
         if (material->twosidedNode) {
             RPR_ERROR_CHECK(material->twosidedNode->SetInput(RPR_MATERIAL_INPUT_BACKFACE, doublesided ? material->rootMaterial : nullptr), "Failed to set back face input of twosided node");
@@ -405,4 +1095,220 @@ void RprMaterialFactory::AttachMaterial(rpr::Curve* curve, HdRprApiMaterial cons
     RPR_ERROR_CHECK(curve->SetMaterial(material ? material->rootMaterial : nullptr), "Failed to set curve material");
 }
 
+void RprMaterialFactory::SetMeshUvs(rpr::Shape* mesh, VtVec2fArray const& uvs, VtIntArray const& uvIndices, VtIntArray const& vpf) {
+    if (uvs.empty() || uvIndices.empty()) {
+        m_meshUdimTiles.erase(mesh);
+        return;
+    }
+
+    // Arrays are shared with the mesh rprim, tiles are computed only if a UDIM material is attached
+    auto& meshTiles = m_meshUdimTiles[mesh];
+    meshTiles.uvs = uvs;
+    meshTiles.uvIndices = uvIndices;
+    meshTiles.vpf = vpf;
+    meshTiles.tiles.clear();
+    meshTiles.isResolved = false;
+}
+
+void RprMaterialFactory::CopyMeshUvs(rpr::Shape* prototypeMesh, rpr::Shape* instanceMesh) {
+    auto it = m_meshUdimTiles.find(prototypeMesh);
+    if (it != m_meshUdimTiles.end()) {
+        m_meshUdimTiles[instanceMesh] = it->second;
+    } else {
+        m_meshUdimTiles.erase(instanceMesh);
+    }
+}
+
+std::vector<uint32_t> const* RprMaterialFactory::GetMeshUdimTiles(rpr::Shape* mesh) {
+    auto it = m_meshUdimTiles.find(mesh);
+    if (it == m_meshUdimTiles.end()) {
+        return nullptr;
+    }
+
+    auto& meshTiles = it->second;
+    if (!meshTiles.isResolved) {
+        meshTiles.tiles = GetUdimTiles(meshTiles.uvs, meshTiles.uvIndices, meshTiles.vpf);
+        meshTiles.isResolved = true;
+    }
+    return &meshTiles.tiles;
+}
+
+void RprMaterialFactory::ReleaseMesh(rpr::Shape* mesh) {
+    SetMeshUdimMaterial(mesh, nullptr);
+    m_meshUdimTiles.erase(mesh);
+}
+
+void RprMaterialFactory::SetMeshUdimMaterial(rpr::Shape* mesh, HdRprApiMaterial* material) {
+    if (material && material->udimTextures.empty()) {
+        material = nullptr;
+    }
+
+    auto materialIt = m_meshUdimMaterials.find(mesh);
+    auto prevMaterial = materialIt != m_meshUdimMaterials.end() ? materialIt->second : nullptr;
+    if (prevMaterial == material) {
+        return;
+    }
+
+    auto tiles = GetMeshUdimTiles(mesh);
+    auto updateTileUsage = [this, tiles](HdRprApiMaterial* material, int delta) {
+        if (tiles) {
+            for (auto tile : *tiles) {
+                if ((material->udimTileUsage[tile] += delta) <= 0) {
+                    material->udimTileUsage.erase(tile);
+                }
+            }
+        }
+        m_materialsWithDirtyUdimTiles.insert(material);
+    };
+
+    if (prevMaterial) {
+        updateTileUsage(prevMaterial, -1);
+        m_meshUdimMaterials.erase(materialIt);
+    }
+    if (material) {
+        updateTileUsage(material, 1);
+        m_meshUdimMaterials.emplace(mesh, material);
+    }
+    UpdatePendingTexturesState();
+}
+
+bool RprMaterialFactory::CommitAtlasPages() {
+    if (!m_atlas || !m_atlas->HasUncommittedPages()) {
+        return false;
+    }
+
+    bool isAnyPageBound = false;
+    for (auto page : m_atlas->CommitPages()) {
+        auto image = m_atlas->GetPageImage(page);
+        auto materialsIt = m_atlasPageMaterials.find(page);
+        if (materialsIt == m_atlasPageMaterials.end()) {
+            continue;
+        }
+
+        for (auto material : materialsIt->second) {
+            for (auto& atlasTexture : material->atlasTextures) {
+                if (atlasTexture.page == page && atlasTexture.image != image) {
+                    RPR_ERROR_CHECK(atlasTexture.imageNode->SetInput(RPR_MATERIAL_INPUT_DATA, image.get()), "Failed to set material node image data input");
+                    atlasTexture.image = image;
+                    isAnyPageBound = true;
+                }
+            }
+        }
+    }
+
+    auto stats = m_atlas->GetStats();
+    TF_DEBUG(HD_RPR_DEBUG_IMAGE_CACHE).Msg("Texture atlas: %zu textures in %zu pages, %.1f%% occupied\n",
+        stats.numTextures, stats.numPages, stats.totalPixels ? 100.0 * stats.usedPixels / stats.totalPixels : 0.0);
+
+    return isAnyPageBound;
+}
+
+bool RprMaterialFactory::UpdateUdimTextures(HdRprApiMaterial* material, bool* isLoading) {
+    std::vector<uint32_t> tiles;
+    for (auto& entry : material->udimTileUsage) {
+        tiles.push_back(entry.first);
+    }
+    if (tiles.empty()) {
+        // Images stay bound until the material is attached to another mesh
+        return false;
+    }
+
+    bool isAnyTextureChanged = false;
+    for (auto& udimTexture : material->udimTextures) {
+        if (udimTexture.boundTiles == tiles && !udimTexture.isStale) {
+            continue;
+        }
+
+        // Commits that wait for tiles to load reuse the lookup of the same tile set
+        bool revalidateMissing = udimTexture.resolvedTiles != tiles;
+        udimTexture.resolvedTiles = tiles;
+
+        std::vector<std::pair<uint32_t, std::shared_ptr<rpr::Image>>> tileImages;
+        bool isTextureLoading = false;
+        for (auto tile : tiles) {
+            auto tileTexture = udimTexture.texture;
+            tileTexture.path = GetUdimTilePath(udimTexture.texture.path, tile);
+            if (!HasUdimTileFile(&udimTexture, tile, tileTexture.path, revalidateMissing)) {
+                // UDIM sets are not required to have all tiles covered by UVs
+                continue;
+            }
+
+            bool isTileLoading = false;
+            std::shared_ptr<rpr::Image> image;
+            auto variant = GetImageVariant(m_imageCache, tileTexture, udimTexture.maxResolution);
+            if (udimTexture.loadingTiles.erase(tile) && !m_imageCache->IsImageLoading(tileTexture.path, variant)) {
+                // Loading of the tile is finished, it failed if the image was not committed.
+                // Requesting it again would start decoding of the same file
+                image = m_imageCache->GetLoadedImage(tileTexture.path, variant);
+            } else {
+                image = GetTextureImage(tileTexture, udimTexture.maxResolution, &isTileLoading);
+            }
+
+            if (image) {
+                tileImages.emplace_back(tile, std::move(image));
+            } else if (isTileLoading) {
+                udimTexture.loadingTiles.insert(tile);
+            } else {
+                // Failed tiles are skipped until their files change, the same way as missing ones
+                udimTexture.foundTiles.erase(tile);
+                AddMissingUdimTile(&udimTexture, tile, tileTexture.path);
+            }
+            isTextureLoading |= isTileLoading;
+        }
+        if (isTextureLoading) {
+            // Previously bound tiles stay until all tiles are loaded
+            *isLoading = true;
+            continue;
+        }
+
+        rpr::Status status;
+        std::shared_ptr<rpr::Image> udimImage(rpr::CreateUdimImage(m_imageCache->GetContext(), &status));
+        if (!udimImage) {
+            RPR_ERROR_CHECK(status, "Failed to create UDIM image");
+            continue;
+        }
+
+        std::vector<std::shared_ptr<rpr::Image>> images = {udimImage};
+        for (auto& tileImage : tileImages) {
+            if (!RPR_ERROR_CHECK(rpr::SetUdimTile(udimImage.get(), tileImage.first, tileImage.second.get()), "Failed to set UDIM tile")) {
+                images.push_back(std::move(tileImage.second));
+            }
+        }
+        if (RPR_ERROR_CHECK(udimTexture.imageNode->SetInput(RPR_MATERIAL_INPUT_DATA, udimImage.get()), "Failed to set material node image data input")) {
+            continue;
+        }
+
+        // Tiles that are not used anymore are left to the image cache
+        udimTexture.images = std::move(images);
+        udimTexture.boundTiles = tiles;
+        udimTexture.isStale = false;
+        m_imageCache->RequireGarbageCollection();
+        isAnyTextureChanged = true;
+    }
+
+    return isAnyTextureChanged;
+}
+
+bool RprMaterialFactory::HasUdimTileFile(HdRprApiMaterial::UdimTextureNode* udimTexture, uint32_t tile, std::string const& tilePath, bool revalidateMissing) {
+    if (udimTexture->foundTiles.count(tile)) {
+        return true;
+    }
+
+    auto missingTileIt = udimTexture->missingTiles.find(tile);
+    if (missingTileIt != udimTexture->missingTiles.end()) {
+        if (!revalidateMissing || m_imageCache->IsFileUpToDate(missingTileIt->second)) {
+            return false;
+        }
+        udimTexture->missingTiles.erase(missingTileIt);
+    }
+
+    if (TfIsFile(tilePath)) {
+        udimTexture->foundTiles.insert(tile);
+        return true;
+    }
+
+    AddMissingUdimTile(udimTexture, tile, tilePath);
+    return false;
+}
+
 PXR_NAMESPACE_CLOSE_SCOPE
\ No newline at end of file
@@ -16,8 +16,17 @@ limitations under the License.
 
 #include "pxr/pxr.h"
 #include "materialAdapter.h"
+#include "imageCache.h"
 
+#include "pxr/base/vt/array.h"
+#include "pxr/base/gf/vec2f.h"
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <atomic>
 #include <vector>
+#include <unordered_map>
 
 namespace rpr { class MaterialNode; class Image; class Shape; class Curve; }
 
@@ -28,23 +37,187 @@ struct HdRprApiMaterial {
     rpr::MaterialNode* twosidedNode = nullptr;
     rpr::MaterialNode* displacementMaterial = nullptr;
     std::vector<rpr::MaterialNode*> materialNodes;
+    /// Nodes from the factory node pool referenced by this material, released to the pool with the material
+    std::vector<rpr::MaterialNode*> sharedNodes;
     std::vector<std::shared_ptr<rpr::Image>> materialImages;
+    /// Normal map nodes in the order of MaterialAdapter::GetNormalMapParams, nullptr if the node was not created
+    std::vector<rpr::MaterialNode*> normalMapNodes;
+
+    struct TextureNode {
+        rpr::MaterialNode* imageNode;
+        /// Image currently bound to imageNode
+        rpr::Image* image;
+        MaterialTexture texture;
+        /// Resolution limit the texture was requested with, 0 means full resolution
+        uint32_t maxResolution;
+        /// Inputs of the root material that are unset if the texture fails to load, empty once a real image is bound
+        std::vector<rpr::MaterialNodeInput> rootInputs;
+    };
+    /// Image texture nodes that use placeholder or lower resolution image while their texture is loading
+    std::vector<TextureNode> pendingTextures;
+    /// Image texture nodes that were loaded with resolution limit
+    std::vector<TextureNode> reducedTextures;
+
+    struct UdimTextureNode {
+        rpr::MaterialNode* imageNode;
+        /// Texture with kUdimTag in the path
+        MaterialTexture texture;
+        uint32_t maxResolution;
+        /// Tiles of the bound UDIM image
+        std::vector<uint32_t> boundTiles;
+        /// Bound image followed by its tiles
+        std::vector<std::shared_ptr<rpr::Image>> images;
+        /// Whether tiles should be reloaded even if the tile set did not change
+        bool isStale = false;
+        /// Tiles which files are known to exist. Tile files are looked up once per material translation
+        std::set<uint32_t> foundTiles;
+        /// Tiles which files were not found or failed to load, they are rechecked according to the image cache
+        /// validation mode when the set of covered tiles changes
+        std::map<uint32_t, ImageCache::ImageMetadata> missingTiles;
+        /// Tiles which images were loading on the last update
+        std::set<uint32_t> loadingTiles;
+        /// Covered tiles for which missing tiles were checked last time
+        std::vector<uint32_t> resolvedTiles;
+    };
+    /// Image texture nodes of UDIM sets, only tiles covered by UVs of attached meshes are loaded
+    std::vector<UdimTextureNode> udimTextures;
+    /// Number of attached meshes that cover each UDIM tile
+    std::map<uint32_t, int> udimTileUsage;
+
+    struct AtlasTextureNode {
+        rpr::MaterialNode* imageNode;
+        uint32_t page;
+        /// Bound page image, nullptr while the page is not committed
+        std::shared_ptr<rpr::Image> image;
+    };
+    /// Image texture nodes that sample texture atlas pages
+    std::vector<AtlasTextureNode> atlasTextures;
 };
 
-class ImageCache;
+class ImageAtlas;
 
 class RprMaterialFactory {
 public:
     RprMaterialFactory(ImageCache* imageCache);
+    ~RprMaterialFactory();
 
+    /// Materials with equal type and adapter share the same RPR material graph.
+    /// Each returned material should be released once
     HdRprApiMaterial* CreateMaterial(EMaterialType type, MaterialAdapter const& materialAdapter);
     void Release(HdRprApiMaterial* material);
 
+    /// Sets new parameter values on the existing node graph of material when materialAdapter
+    /// differs from the one material was created with only by parameter values.
+    /// Returns false if the graph has to be recreated: topology or textures changed,
+    /// or the material is shared with other users
+    bool UpdateMaterial(HdRprApiMaterial* material, EMaterialType type, MaterialAdapter const& materialAdapter);
+
+    /// Number of CreateMaterial calls that returned already existing material
+    size_t GetNumDeduplicatedMaterials() const { return m_numDeduplicatedMaterials; }
+
     void AttachMaterial(rpr::Shape* mesh, HdRprApiMaterial const* material, bool doublesided, bool displacementEnabled);
     void AttachMaterial(rpr::Curve* mesh, HdRprApiMaterial const* material);
 
+    /// UVs of the mesh, UDIM textures load only tiles covered by UVs of meshes their material is attached to.
+    /// Face-varying uvIndices index uvs for each vertex of each face
+    void SetMeshUvs(rpr::Shape* mesh, VtVec2fArray const& uvs, VtIntArray const& uvIndices, VtIntArray const& vpf);
+    void CopyMeshUvs(rpr::Shape* prototypeMesh, rpr::Shape* instanceMesh);
+    /// Should be called before the mesh is deleted
+    void ReleaseMesh(rpr::Shape* mesh);
+
+    /// Replaces placeholders with textures that finished loading. Returns true if any material was changed
+    bool CommitLoadedTextures();
+    /// Can be called from any thread, the state is updated by the calls made under the RPR lock
+    bool HasPendingTextures() const { return m_hasPendingTextures; }
+
+    /// Limits resolution of textures loaded by new materials, 0 means full resolution.
+    /// When the limit is raised, textures of existing materials are reloaded in higher resolution.
+    /// Returns true if any material was changed
+    bool SetTextureMaxResolution(uint32_t maxResolution);
+
+private:
+    HdRprApiMaterial* CreateMaterialGraph(EMaterialType type, MaterialAdapter const& materialAdapter);
+    void ReleaseMaterialGraph(HdRprApiMaterial* material);
+    size_t GetMaterialHash(EMaterialType type, MaterialAdapter const& materialAdapter);
+
+    struct SharedNodeInput {
+        rpr::MaterialNodeInput input;
+        rpr::MaterialNode* node = nullptr;
+        GfVec4f value = GfVec4f(0.0f);
+        uint32_t uintValue = 0;
+        bool isUint = false;
+
+        SharedNodeInput(rpr::MaterialNodeInput input, rpr::MaterialNode* node) : input(input), node(node) {}
+        SharedNodeInput(rpr::MaterialNodeInput input, GfVec4f const& value) : input(input), value(value) {}
+        SharedNodeInput(rpr::MaterialNodeInput input, uint32_t value) : input(input), uintValue(value), isUint(true) {}
+
+        bool operator<(SharedNodeInput const& rhs) const;
+    };
+    using SharedNodeKey = std::pair<rpr::MaterialNodeType, std::vector<SharedNodeInput>>;
+
+    /// Returns node with the given type and constant inputs from the node pool, creates it if there is no such node yet.
+    /// Pooled nodes are immutable and referenced by material until it's released
+    rpr::MaterialNode* AcquireSharedNode(HdRprApiMaterial* material, rpr::MaterialNodeType type, std::vector<SharedNodeInput> inputs);
+    void ReleaseSharedNode(rpr::MaterialNode* node);
+
+    /// Returns 1x1 image with the given pixel, images are shared while they are in use
+    std::shared_ptr<rpr::Image> GetPlaceholderImage(GfVec4f const& pixel);
+    std::shared_ptr<rpr::Image> GetTextureImage(MaterialTexture const& texture, uint32_t maxResolution, bool* isLoading);
+    void BindTextureImage(HdRprApiMaterial* material, HdRprApiMaterial::TextureNode textureNode, std::shared_ptr<rpr::Image> image);
+
+    void SetMeshUdimMaterial(rpr::Shape* mesh, HdRprApiMaterial* material);
+    /// Returns nullptr if the mesh has no UVs
+    std::vector<uint32_t> const* GetMeshUdimTiles(rpr::Shape* mesh);
+    /// Binds UDIM images with the tiles used by the material. Returns true if any image was rebound
+    bool UpdateUdimTextures(HdRprApiMaterial* material, bool* isLoading);
+    bool HasUdimTileFile(HdRprApiMaterial::UdimTextureNode* udimTexture, uint32_t tile, std::string const& tilePath, bool revalidateMissing);
+    /// Binds recreated atlas pages to the materials that sample them. Returns true if any page was rebound
+    bool CommitAtlasPages();
+    void UpdatePendingTexturesState();
+
 private:
     ImageCache* m_imageCache;
+
+    std::map<std::tuple<float, float, float, float>, std::weak_ptr<rpr::Image>> m_placeholderImages;
+    std::set<HdRprApiMaterial*> m_materialsWithPendingTextures;
+    std::set<HdRprApiMaterial*> m_materialsWithReducedTextures;
+    uint32_t m_textureMaxResolution = 0;
+
+    std::set<HdRprApiMaterial*> m_materialsWithUdimTextures;
+    std::set<HdRprApiMaterial*> m_materialsWithDirtyUdimTiles;
+    struct MeshUdimTiles {
+        VtVec2fArray uvs;
+        VtIntArray uvIndices;
+        VtIntArray vpf;
+        /// Tiles covered by UVs, computed when a UDIM material is attached to the mesh for the first time
+        std::vector<uint32_t> tiles;
+        bool isResolved = false;
+    };
+    std::unordered_map<rpr::Shape*, MeshUdimTiles> m_meshUdimTiles;
+    std::unordered_map<rpr::Shape*, HdRprApiMaterial*> m_meshUdimMaterials;
+
+    std::unique_ptr<ImageAtlas> m_atlas;
+    std::map<uint32_t, std::set<HdRprApiMaterial*>> m_atlasPageMaterials;
+
+    std::atomic<bool> m_hasPendingTextures{false};
+
+    struct SharedMaterial {
+        EMaterialType type;
+        MaterialAdapter adapter;
+        HdRprApiMaterial* material;
+        size_t refCount;
+    };
+    std::unordered_multimap<size_t, SharedMaterial> m_sharedMaterials;
+    std::unordered_map<HdRprApiMaterial*, size_t> m_sharedMaterialHashes;
+    size_t m_numDeduplicatedMaterials = 0;
+
+    struct SharedNode {
+        rpr::MaterialNode* node;
+        size_t refCount;
+    };
+    using SharedNodeMap = std::map<SharedNodeKey, SharedNode>;
+    SharedNodeMap m_sharedNodes;
+    std::unordered_map<rpr::MaterialNode*, SharedNodeMap::iterator> m_sharedNodeKeys;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
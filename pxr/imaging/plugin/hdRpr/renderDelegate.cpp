@@ -34,8 +34,10 @@ limitations under the License.
 #ifdef USE_VOLUME
 #include "volume.h"
 #include "field.h"
+#include "vdbGridCache.h"
 #endif
 
+#include <atomic>
 #include <ctime>
 #include <iomanip>
 #include <sstream>
@@ -44,6 +46,7 @@ limitations under the License.
 PXR_NAMESPACE_OPEN_SCOPE
 
 static HdRprApi* g_rprApi = nullptr;
+static std::atomic<int> g_numRenderDelegates(0);
 
 class HdRprDiagnosticMgrDelegate : public TfDiagnosticMgr::Delegate {
 public:
@@ -147,6 +150,7 @@ const TfTokenVector HdRprDelegate::SUPPORTED_BPRIM_TYPES = {
 };
 
 HdRprDelegate::HdRprDelegate() {
+    ++g_numRenderDelegates;
     m_rprApi.reset(new HdRprApi(this));
     g_rprApi = m_rprApi.get();
 
@@ -177,6 +181,13 @@ HdRprDelegate::HdRprDelegate() {
 
 HdRprDelegate::~HdRprDelegate() {
     g_rprApi = nullptr;
+
+    if (--g_numRenderDelegates == 0) {
+#ifdef USE_VOLUME
+        // VDB cache outlives render delegates, its background tasks must finish while TBB is alive
+        VdbGridCache::GetInstance().StopPrefetching();
+#endif
+    }
 }
 
 HdRenderParam* HdRprDelegate::GetRenderParam() const {
@@ -187,6 +198,8 @@ void HdRprDelegate::CommitResources(HdChangeTracker* tracker) {
     // CommitResources() is called after prim sync has finished, but before any
     // tasks (such as draw tasks) have run.
 
+    m_renderParam->CommitMaterials(tracker);
+    m_renderParam->UpdateVolumeResolution(tracker);
 }
 
 TfToken HdRprDelegate::GetMaterialNetworkSelector() const {
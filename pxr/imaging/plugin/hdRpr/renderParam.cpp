@@ -12,7 +12,12 @@ limitations under the License.
 ************************************************************************/
 
 #include "renderParam.h"
+#include "material.h"
+#include "light.h"
+#include "volume.h"
+#include "rprApi.h"
 
+#include "pxr/imaging/hd/changeTracker.h"
 #include "pxr/base/tf/envSetting.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
@@ -26,4 +31,77 @@ void HdRprRenderParam::InitializeEnvParameters() {
     m_materialNetworkSelector = TfToken(TfGetEnvSetting(HDRPR_MATERIAL_NETWORK_SELECTOR));
 }
 
+void HdRprRenderParam::CommitMaterials(HdChangeTracker* tracker) {
+    for (auto material : m_materialsToCommit) {
+        material->GetRprMaterialObject();
+    }
+    m_materialsToCommit.clear();
+
+    // Remaining tasks are no-ops at this point, waiting reports errors issued during translation
+    m_materialTranslationDispatcher.Wait();
+
+    // Rprims were marked dirty when the previous commit replaced materials, they have rebound during this prim sync
+    if (!m_materialsAwaitingRebind.empty()) {
+        auto rprApi = AcquireRprApiForEdit();
+        for (auto material : m_materialsAwaitingRebind) {
+            rprApi->Release(material);
+        }
+        m_materialsAwaitingRebind.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_materialsToReleaseMutex);
+        std::swap(m_materialsAwaitingRebind, m_materialsToRelease);
+    }
+    if (!m_materialsAwaitingRebind.empty()) {
+        // Material prims do not know which rprims are bound to them. Graphs are replaced only
+        // when the network topology or textures change, so rebinding all rprims is rare
+        tracker->MarkAllRprimsDirty(HdChangeTracker::DirtyMaterialId);
+    }
+}
+
+void HdRprRenderParam::ReleaseMaterialAfterCommit(HdRprApiMaterial* material) {
+    if (material) {
+        std::lock_guard<std::mutex> lock(m_materialsToReleaseMutex);
+        m_materialsToRelease.push_back(material);
+    }
+}
+
+void HdRprRenderParam::AddVolume(HdRprVolume* volume) {
+    std::lock_guard<std::mutex> lock(m_volumesMutex);
+    m_volumes.insert(volume);
+}
+
+void HdRprRenderParam::RemoveVolume(HdRprVolume* volume) {
+    std::lock_guard<std::mutex> lock(m_volumesMutex);
+    m_volumes.erase(volume);
+}
+
+void HdRprRenderParam::UpdateVolumeResolution(HdChangeTracker* tracker) {
+    // Render quality is applied by the render thread, volumes are resynced in the next prim sync after that
+    int renderQuality = m_rprApi->GetCurrentRenderQuality();
+
+    std::lock_guard<std::mutex> lock(m_volumesMutex);
+    for (auto volume : m_volumes) {
+        if (volume->GetSyncedRenderQuality() != renderQuality) {
+            tracker->MarkRprimDirty(volume->GetId(), HdRprVolume::GetFieldDirtyBits());
+        }
+    }
+}
+
+void HdRprRenderParam::UpdateLightSimplification() {
+    if (m_simplifiableLights.empty()) {
+        return;
+    }
+
+    auto cameraPosition = GfVec3f(m_rprApi->GetCameraViewMatrix().GetInverse().ExtractTranslation());
+    bool isInteractive = m_rprApi->IsInteractive();
+    for (auto light : m_simplifiableLights) {
+        bool simplify = light->IsSimplificationWanted(cameraPosition, isInteractive);
+        if (simplify != light->IsSimplified()) {
+            light->SetSimplified(AcquireRprApiForEdit(), simplify);
+        }
+    }
+}
+
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -17,6 +17,11 @@ limitations under the License.
 #include "renderThread.h"
 
 #include "pxr/imaging/hd/renderDelegate.h"
+#include "pxr/base/work/dispatcher.h"
+
+#include <set>
+#include <mutex>
+#include <vector>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
@@ -27,6 +32,10 @@ PXR_NAMESPACE_OPEN_SCOPE
 TF_DECLARE_PUBLIC_TOKENS(HdRprMaterialNetworkSelectorTokens, HDRPR_MATERIAL_NETWORK_SELECTOR_TOKENS);
 
 class HdRprApi;
+class HdRprLight;
+class HdRprMaterial;
+class HdRprVolume;
+struct HdRprApiMaterial;
 
 class HdRprRenderParam final : public HdRenderParam {
 public:
@@ -52,6 +61,32 @@ public:
 
     TfToken const& GetMaterialNetworkSelector() const { return m_materialNetworkSelector; }
 
+    /// Runs translation of material networks on worker threads while sprims are synced
+    WorkDispatcher& GetMaterialTranslationDispatcher() { return m_materialTranslationDispatcher; }
+
+    /// Materials whose translation was not committed yet. Rprims commit materials they use while syncing,
+    /// the rest are committed after prim sync so that in-place updates of unused materials are not lost
+    void AddMaterialToCommit(HdRprMaterial* material) { m_materialsToCommit.insert(material); }
+    void RemoveMaterialToCommit(HdRprMaterial* material) { m_materialsToCommit.erase(material); }
+    void CommitMaterials(HdChangeTracker* tracker);
+
+    /// Material replaced by its material prim stays bound to rprims until they sync their material binding.
+    /// CommitMaterials marks rprims dirty and releases the material in the next commit, once rprims have rebound.
+    /// Can be called from any thread
+    void ReleaseMaterialAfterCommit(HdRprApiMaterial* material);
+
+    /// Volumes choose grid resolution by render quality. Can be called from any thread
+    void AddVolume(HdRprVolume* volume);
+    void RemoveVolume(HdRprVolume* volume);
+    /// Marks volumes dirty when render quality changed since they loaded their fields
+    void UpdateVolumeResolution(HdChangeTracker* tracker);
+
+    /// Area lights that can be substituted by analytic lights depending on their size on screen
+    void AddSimplifiableLight(HdRprLight* light) { m_simplifiableLights.insert(light); }
+    void RemoveSimplifiableLight(HdRprLight* light) { m_simplifiableLights.erase(light); }
+    /// Switches lights between area and analytic representations for the current camera and render quality
+    void UpdateLightSimplification();
+
 private:
     void InitializeEnvParameters();
 
@@ -61,6 +96,15 @@ private:
     std::atomic<uint32_t> m_numLights;
 
     TfToken m_materialNetworkSelector;
+
+    WorkDispatcher m_materialTranslationDispatcher;
+    std::set<HdRprMaterial*> m_materialsToCommit;
+    std::mutex m_materialsToReleaseMutex;
+    std::vector<HdRprApiMaterial*> m_materialsToRelease;
+    std::vector<HdRprApiMaterial*> m_materialsAwaitingRebind;
+    std::set<HdRprLight*> m_simplifiableLights;
+    std::mutex m_volumesMutex;
+    std::set<HdRprVolume*> m_volumes;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
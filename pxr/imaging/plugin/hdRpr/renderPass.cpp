@@ -71,6 +71,8 @@ void HdRprRenderPass::_Execute(HdRenderPassStateSharedPtr const& renderPassState
         m_renderParam->AcquireRprApiForEdit()->SetCamera(renderPassState->GetCamera());
     }
 
+    m_renderParam->UpdateLightSimplification();
+
     if (rprApiConst->IsChanged()) {
         for (auto& aovBinding : renderPassState->GetAovBindings()) {
             if (aovBinding.renderBuffer) {
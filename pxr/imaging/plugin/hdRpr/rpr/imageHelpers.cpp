@@ -15,16 +15,20 @@ limitations under the License.
 #include "helpers.h"
 
 #include "pxr/imaging/glf/glew.h"
-#include "pxr/imaging/glf/uvTextureData.h"
 #include "pxr/imaging/glf/image.h"
 #include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/gf/half.h"
 
 #ifdef ENABLE_RAT
 #include <IMG/IMG_File.h>
 #include <PXL/PXL_Raster.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <new>
+#include <memory>
 #include <vector>
 #include <array>
 
@@ -50,13 +54,116 @@ ImageDesc GetRprImageDesc(ImageFormat format, uint32_t width, uint32_t height, u
     return desc;
 }
 
+template <typename T>
+T ToComponent(float value) {
+    return T(value);
+}
+
+template <>
+uint8_t ToComponent<uint8_t>(float value) {
+    return uint8_t(value + 0.5f);
+}
+
+/// Halves resolution using 2x2 box filter
+template <typename T>
+void DownsampleByHalf(T const* src, uint32_t srcWidth, uint32_t srcHeight, uint32_t numComponents, T* dst, uint32_t dstWidth, uint32_t dstHeight) {
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        auto srcRow0 = src + size_t(std::min(2 * y, srcHeight - 1)) * srcWidth * numComponents;
+        auto srcRow1 = src + size_t(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * numComponents;
+        auto dstRow = dst + size_t(y) * dstWidth * numComponents;
+
+        for (uint32_t x = 0; x < dstWidth; ++x) {
+            auto x0 = std::min(2 * x, srcWidth - 1) * numComponents;
+            auto x1 = std::min(2 * x + 1, srcWidth - 1) * numComponents;
+            for (uint32_t c = 0; c < numComponents; ++c) {
+                float sum = float(srcRow0[x0 + c]) + float(srcRow0[x1 + c]) + float(srcRow1[x0 + c]) + float(srcRow1[x1 + c]);
+                dstRow[x * numComponents + c] = ToComponent<T>(sum * 0.25f);
+            }
+        }
+    }
+}
+
+void DownsampleImage(ImageData* data, uint32_t maxResolution) {
+    PXR_NAMESPACE_USING_DIRECTIVE
+
+    while (maxResolution && std::max(data->width, data->height) > maxResolution) {
+        uint32_t width = std::max(data->width / 2, 1u);
+        uint32_t height = std::max(data->height / 2, 1u);
+        auto desc = GetRprImageDesc(data->format, width, height);
+        auto pixels = std::make_shared<std::vector<uint8_t>>(desc.image_slice_pitch);
+
+        auto numComponents = data->format.num_components;
+        if (data->format.type == RPR_COMPONENT_TYPE_UINT8) {
+            DownsampleByHalf(static_cast<uint8_t const*>(data->data), data->width, data->height, numComponents, pixels->data(), width, height);
+        } else if (data->format.type == RPR_COMPONENT_TYPE_FLOAT16) {
+            DownsampleByHalf(static_cast<GfHalf const*>(data->data), data->width, data->height, numComponents, reinterpret_cast<GfHalf*>(pixels->data()), width, height);
+        } else if (data->format.type == RPR_COMPONENT_TYPE_FLOAT32) {
+            DownsampleByHalf(static_cast<float const*>(data->data), data->width, data->height, numComponents, reinterpret_cast<float*>(pixels->data()), width, height);
+        } else {
+            return;
+        }
+
+        data->width = width;
+        data->height = height;
+        data->data = pixels->data();
+        data->dataOwner = std::move(pixels);
+        data->isDownsampled = true;
+    }
+}
+
+template <typename T>
+void ExtractChannel(T const* src, size_t numPixels, uint32_t numComponents, int channel, T* dst) {
+    if (channel < 0) {
+        std::fill(dst, dst + numPixels, T(1.0f));
+        return;
+    }
+
+    for (size_t i = 0; i < numPixels; ++i) {
+        dst[i] = src[i * numComponents + channel];
+    }
+}
+
+float ReadComponent(void const* data, rpr_component_type type, size_t index) {
+    PXR_NAMESPACE_USING_DIRECTIVE
+
+    if (type == RPR_COMPONENT_TYPE_UINT8) {
+        return static_cast<uint8_t const*>(data)[index] * (1.0f / 255.0f);
+    } else if (type == RPR_COMPONENT_TYPE_FLOAT16) {
+        return static_cast<GfHalf const*>(data)[index];
+    } else {
+        return static_cast<float const*>(data)[index];
+    }
+}
+
+void WriteComponent(void* data, rpr_component_type type, size_t index, float value) {
+    PXR_NAMESPACE_USING_DIRECTIVE
+
+    if (type == RPR_COMPONENT_TYPE_UINT8) {
+        static_cast<uint8_t*>(data)[index] = uint8_t(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    } else if (type == RPR_COMPONENT_TYPE_FLOAT16) {
+        static_cast<GfHalf*>(data)[index] = GfHalf(value);
+    } else {
+        static_cast<float*>(data)[index] = value;
+    }
+}
+
 } // namespace anonymous
 
 Image* CreateImage(Context* context, uint32_t width, uint32_t height, ImageFormat format, void const* data, rpr::Status* status) {
     return context->CreateImage(format, GetRprImageDesc(format, width, height), data, status);
 }
 
-Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
+Image* CreateUdimImage(Context* context, rpr::Status* status) {
+    ImageFormat format = {0, RPR_COMPONENT_TYPE_UINT8};
+    ImageDesc desc = {};
+    return context->CreateImage(format, desc, nullptr, status);
+}
+
+Status SetUdimTile(Image* udimImage, uint32_t tileId, Image* tileImage) {
+    return rprImageSetUDIM(GetRprObject(udimImage), tileId, GetRprObject(tileImage));
+}
+
+bool DecodeImage(char const* path, bool forceLinearSpace, ImageData* outData, uint32_t maxResolution) {
     PXR_NAMESPACE_USING_DIRECTIVE
 
 #ifdef ENABLE_RAT
@@ -65,6 +172,7 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
         auto ratImage = std::unique_ptr<IMG_File>(IMG_File::open(path));
         if (!ratImage) {
             TF_RUNTIME_ERROR("Failed to load image %s", path);
+            return false;
         }
 
         UT_Array<PXL_Raster*> images;
@@ -76,10 +184,13 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
         if (!ratImage->readImages(images) ||
             images.isEmpty()) {
             TF_RUNTIME_ERROR("Failed to load image %s", path);
+            return false;
         }
 
         // XXX: use the only first image, find out what to do with other images
-        auto image = images[0];
+        // The raster itself keeps pixel data alive, so it's taken out of the release list
+        std::shared_ptr<PXL_Raster> image(images[0]);
+        images[0] = nullptr;
 
         rpr_image_format format = {};
         if (image->getPacking() == PACK_SINGLE) {
@@ -92,6 +203,7 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
             format.num_components = 4;
         } else {
             TF_RUNTIME_ERROR("Failed to load image %s: unsupported RAT packing", path);
+            return false;
         }
 
         if (image->getFormat() == PXL_INT8) {
@@ -102,95 +214,331 @@ Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
             format.type = RPR_COMPONENT_TYPE_FLOAT32;
         } else {
             TF_RUNTIME_ERROR("Failed to load image %s: unsupported RAT format", path);
+            return false;
         }
 
         ImageDesc desc = GetRprImageDesc(format, image->getXres(), image->getYres());
         if (desc.image_height < 1 ||
             desc.image_width < 1) {
             TF_RUNTIME_ERROR("Failed to load image %s: incorrect dimensions", path);
+            return false;
         }
 
-        // RAT image is flipped in Y axis
-        std::vector<uint8_t> flippedImage;
-        flippedImage.reserve(image->getStride() * desc.image_height);
-        for (int y = 0; y < desc.image_height; ++y) {
-            auto srcData = reinterpret_cast<uint8_t*>(image->getPixels()) + image->getStride() * y;
-            auto dstData = &flippedImage[image->getStride() * (desc.image_height - 1 - y)];
-            std::memcpy(dstData, srcData, image->getStride());
+        // RAT image is flipped in Y axis, rows are swapped in place
+        auto stride = image->getStride();
+        auto pixels = reinterpret_cast<uint8_t*>(image->getPixels());
+        std::vector<uint8_t> rowBuffer(stride);
+        for (size_t y = 0; y < desc.image_height / 2; ++y) {
+            auto topRow = pixels + stride * y;
+            auto bottomRow = pixels + stride * (desc.image_height - 1 - y);
+            std::memcpy(rowBuffer.data(), topRow, stride);
+            std::memcpy(topRow, bottomRow, stride);
+            std::memcpy(bottomRow, rowBuffer.data(), stride);
         }
 
-        rpr::Status status;
-        auto rprImage = context->CreateImage(format, desc, flippedImage.data(), &status);
-        if (!rprImage) {
-            RPR_ERROR_CHECK(status, "Failed to create image from data", context);
-            return nullptr;
-        }
+        outData->format = format;
+        outData->width = desc.image_width;
+        outData->height = desc.image_height;
+        outData->data = pixels;
+        outData->dataOwner = image;
+        outData->gamma = 0.0f;
+        outData->isDownsampled = false;
+        DownsampleImage(outData, maxResolution);
 
         if (!forceLinearSpace &&
             (image->getColorSpace() == PXL_CS_LINEAR ||
-            image->getColorSpace() == PXL_CS_GAMMA2_2 || 
+            image->getColorSpace() == PXL_CS_GAMMA2_2 ||
             image->getColorSpace() == PXL_CS_CUSTOM_GAMMA)) {
-            RPR_ERROR_CHECK(rprImage->SetGamma(image->getColorSpaceGamma()), "Failed to set image gamma", context);
+            outData->gamma = image->getColorSpaceGamma();
         }
 
-        return rprImage;
+        return true;
     }
 #endif
 
     if (GlfImage::IsSupportedImageFile(path)) {
-        auto textureData = GlfUVTextureData::New(path, INT_MAX, 0, 0, 0, 0);
-        if (textureData && textureData->Read(0, false)) {
-            ImageFormat format = {};
-            switch (textureData->GLType()) {
-            case GL_UNSIGNED_BYTE:
-                format.type = RPR_COMPONENT_TYPE_UINT8;
-                break;
-            case GL_HALF_FLOAT:
-                format.type = RPR_COMPONENT_TYPE_FLOAT16;
-                break;
-            case GL_FLOAT:
-                format.type = RPR_COMPONENT_TYPE_FLOAT32;
-                break;
-            default:
-                TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLtype: %#x", path, textureData->GLType());
+        auto image = GlfImage::OpenForReading(path);
+        if (!image) {
+            return false;
+        }
+
+        // Pick the largest mip level that fits into maxResolution, the rest is downsampled after decoding
+        bool isDownsampled = false;
+        if (maxResolution) {
+            for (int mip = 1; mip < image->GetNumMipLevels() &&
+                              std::max(image->GetWidth(), image->GetHeight()) > int(maxResolution); ++mip) {
+                auto mipImage = GlfImage::OpenForReading(path, 0, mip);
+                if (!mipImage) {
+                    break;
+                }
+                image = std::move(mipImage);
+                isDownsampled = true;
             }
+        }
+
+        ImageFormat format = {};
+        switch (image->GetType()) {
+        case GL_UNSIGNED_BYTE:
+            format.type = RPR_COMPONENT_TYPE_UINT8;
+            break;
+        case GL_HALF_FLOAT:
+            format.type = RPR_COMPONENT_TYPE_FLOAT16;
+            break;
+        case GL_FLOAT:
+            format.type = RPR_COMPONENT_TYPE_FLOAT32;
+            break;
+        default:
+            TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLtype: %#x", path, image->GetType());
+            return false;
+        }
+
+        switch (image->GetFormat()) {
+        case GL_RED:
+            format.num_components = 1;
+            break;
+        case GL_RGB:
+            format.num_components = 3;
+            break;
+        case GL_RGBA:
+            format.num_components = 4;
+            break;
+        default:
+            TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLformat: %#x", path, image->GetFormat());
+            return false;
+        }
+
+        // Decode straight into the buffer that is handed over to the image data
+        auto desc = GetRprImageDesc(format, image->GetWidth(), image->GetHeight());
+        std::shared_ptr<uint8_t> pixels(new (std::nothrow) uint8_t[desc.image_slice_pitch], std::default_delete<uint8_t[]>());
+        if (!pixels) {
+            TF_RUNTIME_ERROR("Failed to allocate memory for image %s", path);
+            return false;
+        }
+
+        GlfImage::StorageSpec storage;
+        storage.width = image->GetWidth();
+        storage.height = image->GetHeight();
+        storage.format = image->GetFormat();
+        storage.type = image->GetType();
+        storage.flipped = false;
+        storage.data = pixels.get();
+        if (!image->Read(storage)) {
+            TF_RUNTIME_ERROR("Failed to read image %s", path);
+            return false;
+        }
+
+        outData->format = format;
+        outData->width = image->GetWidth();
+        outData->height = image->GetHeight();
+        outData->data = pixels.get();
+        outData->dataOwner = std::move(pixels);
+        outData->gamma = 0.0f;
+        outData->isDownsampled = isDownsampled;
+        DownsampleImage(outData, maxResolution);
+
+        if (!forceLinearSpace && image->IsColorSpaceSRGB()) {
+            // XXX(RPR): sRGB formula is different from straight pow decoding, but it's the best we can do right now
+            outData->gamma = 2.2f;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool ExtractImageChannel(ImageData* data, int channel) {
+    PXR_NAMESPACE_USING_DIRECTIVE
+
+    if (channel < 0 || channel > 3 || !data->data) {
+        return false;
+    }
+
+    auto numComponents = data->format.num_components;
+    if (numComponents == 1 && channel < 3) {
+        return true;
+    }
+
+    int srcChannel = channel;
+    if (channel == 3) {
+        // Alpha is never gamma corrected
+        data->gamma = 0.0f;
+        if (numComponents != 2 && numComponents != 4) {
+            srcChannel = -1;
+        } else {
+            srcChannel = numComponents - 1;
+        }
+    } else if (uint32_t(channel) >= numComponents || numComponents == 2) {
+        srcChannel = 0;
+    }
+
+    ImageFormat format = data->format;
+    format.num_components = 1;
+    auto desc = GetRprImageDesc(format, data->width, data->height);
+    auto pixels = std::make_shared<std::vector<uint8_t>>(desc.image_slice_pitch);
+
+    size_t numPixels = size_t(data->width) * data->height;
+    if (format.type == RPR_COMPONENT_TYPE_UINT8) {
+        // 1.0 is 255 for 8-bit images
+        if (srcChannel < 0) {
+            std::fill(pixels->begin(), pixels->end(), uint8_t(255));
+        } else {
+            ExtractChannel(static_cast<uint8_t const*>(data->data), numPixels, numComponents, srcChannel, pixels->data());
+        }
+    } else if (format.type == RPR_COMPONENT_TYPE_FLOAT16) {
+        ExtractChannel(static_cast<GfHalf const*>(data->data), numPixels, numComponents, srcChannel, reinterpret_cast<GfHalf*>(pixels->data()));
+    } else if (format.type == RPR_COMPONENT_TYPE_FLOAT32) {
+        ExtractChannel(static_cast<float const*>(data->data), numPixels, numComponents, srcChannel, reinterpret_cast<float*>(pixels->data()));
+    } else {
+        return false;
+    }
+
+    data->format = format;
+    data->data = pixels->data();
+    data->dataOwner = std::move(pixels);
+    return true;
+}
+
+bool ConvertImage(ImageData* data, float const scale[4], float const bias[4], int channel) {
+    static const float kLuminanceWeights[3] = {0.2126f, 0.7152f, 0.0722f};
+
+    auto numComponents = data->format.num_components;
+    auto type = data->format.type;
+    if (!data->data || numComponents < 1 || numComponents > 4 || channel > kImageChannelLuminance ||
+        (type != RPR_COMPONENT_TYPE_UINT8 && type != RPR_COMPONENT_TYPE_FLOAT16 && type != RPR_COMPONENT_TYPE_FLOAT32)) {
+        return false;
+    }
+
+    bool isLinear = data->gamma <= 0.0f || std::abs(data->gamma - 1.0f) < 1e-3f;
+    bool isIdentity = true;
+    for (int i = 0; i < 4; ++i) {
+        isIdentity &= scale[i] == 1.0f && bias[i] == 0.0f;
+    }
+    if (isLinear && isIdentity && channel < 0) {
+        return true;
+    }
+
+    // Mapping of output components to RGBA components, -1 is luminance
+    std::vector<int> outComponents;
+    if (channel == kImageChannelLuminance) {
+        outComponents = {-1};
+    } else if (channel >= 0) {
+        outComponents = {channel};
+    } else {
+        // Keep the number of components when the result is representable with it
+        bool isRgbUniform = scale[0] == scale[1] && scale[0] == scale[2] &&
+                            bias[0] == bias[1] && bias[0] == bias[2];
+        bool isAlphaOne = scale[3] + bias[3] == 1.0f;
+        if (numComponents == 1 && isRgbUniform && isAlphaOne) {
+            outComponents = {0};
+        } else if (numComponents == 2 && isRgbUniform) {
+            outComponents = {0, 3};
+        } else if (numComponents == 3 && isAlphaOne) {
+            outComponents = {0, 1, 2};
+        } else {
+            outComponents = {0, 1, 2, 3};
+        }
+    }
 
-            switch (textureData->GLFormat()) {
-            case GL_RED:
-                format.num_components = 1;
-                break;
-            case GL_RGB:
-                format.num_components = 3;
-                break;
-            case GL_RGBA:
-                format.num_components = 4;
-                break;
-            default:
-                TF_RUNTIME_ERROR("Failed to create image %s. Unsupported pixel data GLformat: %#x", path, textureData->GLFormat());
+    // 8-bit output is possible only when linear values stay in [0, 1]
+    auto isInUnitRange = [&](int c) {
+        float lo = std::min(bias[c], scale[c] + bias[c]);
+        float hi = std::max(bias[c], scale[c] + bias[c]);
+        return lo >= 0.0f && hi <= 1.0f;
+    };
+    bool isUint8Representable = isLinear;
+    for (int c : outComponents) {
+        if (c < 0) {
+            for (int i = 0; i < 3; ++i) {
+                isUint8Representable &= isInUnitRange(i);
             }
-            ImageDesc desc = GetRprImageDesc(format, textureData->ResizedWidth(), textureData->ResizedHeight());
+        } else {
+            isUint8Representable &= isInUnitRange(c);
+        }
+    }
+
+    ImageFormat format = {};
+    format.num_components = uint32_t(outComponents.size());
+    format.type = type;
+    if (type == RPR_COMPONENT_TYPE_UINT8 && !isUint8Representable) {
+        format.type = RPR_COMPONENT_TYPE_FLOAT16;
+    }
+
+    auto desc = GetRprImageDesc(format, data->width, data->height);
+    auto pixels = std::make_shared<std::vector<uint8_t>>(desc.image_slice_pitch);
 
-            rpr::Status status;
-            auto rprImage = context->CreateImage(format, desc, textureData->GetRawBuffer(), &status);
-            if (!rprImage) {
-                RPR_ERROR_CHECK(status, "Failed to create image from data", context);
-                return nullptr;
+    size_t numPixels = size_t(data->width) * data->height;
+    for (size_t i = 0; i < numPixels; ++i) {
+        float rgba[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        auto srcIndex = i * numComponents;
+        if (numComponents <= 2) {
+            rgba[0] = rgba[1] = rgba[2] = ReadComponent(data->data, type, srcIndex);
+            if (numComponents == 2) {
+                rgba[3] = ReadComponent(data->data, type, srcIndex + 1);
+            }
+        } else {
+            for (uint32_t c = 0; c < numComponents; ++c) {
+                rgba[c] = ReadComponent(data->data, type, srcIndex + c);
             }
+        }
 
-            auto internalFormat = textureData->GLInternalFormat();
-            if (!forceLinearSpace &&
-                (internalFormat == GL_SRGB ||
-                internalFormat == GL_SRGB8 ||
-                internalFormat == GL_SRGB_ALPHA ||
-                internalFormat == GL_SRGB8_ALPHA8)) {
-                // XXX(RPR): sRGB formula is different from straight pow decoding, but it's the best we can do right now
-                RPR_ERROR_CHECK(rprImage->SetGamma(2.2f), "Failed to set image gamma");
+        for (int c = 0; c < 4; ++c) {
+            if (!isLinear && c < 3) {
+                // Alpha is never gamma corrected
+                rgba[c] = std::pow(std::max(rgba[c], 0.0f), data->gamma);
             }
+            rgba[c] = rgba[c] * scale[c] + bias[c];
+        }
 
-            return rprImage;
+        auto dstIndex = i * outComponents.size();
+        for (size_t j = 0; j < outComponents.size(); ++j) {
+            int c = outComponents[j];
+            float value = c >= 0 ? rgba[c] : rgba[0] * kLuminanceWeights[0] + rgba[1] * kLuminanceWeights[1] + rgba[2] * kLuminanceWeights[2];
+            WriteComponent(pixels->data(), format.type, dstIndex + j, value);
         }
     }
 
+    data->format = format;
+    data->data = pixels->data();
+    data->dataOwner = std::move(pixels);
+    data->gamma = 0.0f;
+    return true;
+}
+
+bool IsDecodableImage(char const* path) {
+    PXR_NAMESPACE_USING_DIRECTIVE
+
+#ifdef ENABLE_RAT
+    auto dot = strrchr(path, '.');
+    if (dot && strcmp(dot, ".rat") == 0) {
+        return true;
+    }
+#endif
+
+    return GlfImage::IsSupportedImageFile(path);
+}
+
+Image* CreateImage(Context* context, ImageData const& data) {
+    rpr::Status status;
+    auto rprImage = context->CreateImage(data.format, GetRprImageDesc(data.format, data.width, data.height), data.data, &status);
+    if (!rprImage) {
+        RPR_ERROR_CHECK(status, "Failed to create image from data", context);
+        return nullptr;
+    }
+
+    if (data.gamma > 0.0f) {
+        RPR_ERROR_CHECK(rprImage->SetGamma(data.gamma), "Failed to set image gamma", context);
+    }
+
+    return rprImage;
+}
+
+Image* CreateImage(Context* context, char const* path, bool forceLinearSpace) {
+    ImageData data;
+    if (DecodeImage(path, forceLinearSpace, &data)) {
+        return CreateImage(context, data);
+    }
+
     return context->CreateImageFromFile(path);
 }
 
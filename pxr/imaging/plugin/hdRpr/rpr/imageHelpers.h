@@ -16,11 +16,51 @@ limitations under the License.
 
 #include <RadeonProRender.hpp>
 
+#include <memory>
+
 namespace rpr {
 
+/// Decoded image ready to be passed to RPR
+struct ImageData {
+    ImageFormat format = {};
+    uint32_t width = 0;
+    uint32_t height = 0;
+    void const* data = nullptr;
+    /// Keeps data alive
+    std::shared_ptr<void const> dataOwner;
+    /// Gamma to be set on the image, 0 means the image is left as is
+    float gamma = 0.0f;
+    /// Whether the image has lower resolution than the source file
+    bool isDownsampled = false;
+};
+
+/// Decodes image file without using RPR. Can be called from any thread.
+/// Images larger than maxResolution in any dimension are loaded from a smaller mip level or downsampled, 0 means no limit
+bool DecodeImage(char const* path, bool forceLinearSpace, ImageData* outData, uint32_t maxResolution = 0);
+/// Replaces image data with one-component image of the channel. Missing color channels are taken
+/// from the first channel (grayscale images), missing alpha channel is filled with 1
+bool ExtractImageChannel(ImageData* data, int channel);
+
+/// Channel index that means luminance of RGB channels
+const int kImageChannelLuminance = 4;
+
+/// Replaces image data with value * scale + bias computed from linearized values, optionally followed by
+/// extraction of a single channel (0-3 or kImageChannelLuminance) into one-component image.
+/// Images with less than 4 components are treated the same way RPR samples them: grayscale replicated to RGB and alpha is 1.
+/// 8-bit images are converted to 16-bit float when the result can not be represented in 8 bits
+bool ConvertImage(ImageData* data, float const scale[4], float const bias[4], int channel = -1);
+/// Whether DecodeImage supports the file format
+bool IsDecodableImage(char const* path);
+
+Image* CreateImage(Context* context, ImageData const& data);
 Image* CreateImage(Context* context, char const* path, bool forceLinearSpace = false);
 Image* CreateImage(Context* context, uint32_t width, uint32_t height, ImageFormat format, void const* data, rpr::Status* status = nullptr);
 
+/// Creates image without own data that samples the tile images set by SetUdimTile.
+/// UV tile (u, v) is sampled from the tile with id 1001 + u + 10 * v
+Image* CreateUdimImage(Context* context, rpr::Status* status = nullptr);
+Status SetUdimTile(Image* udimImage, uint32_t tileId, Image* tileImage);
+
 ImageFormat GetImageFormat(Image* image);
 ImageDesc GetImageDesc(Image* image);
 
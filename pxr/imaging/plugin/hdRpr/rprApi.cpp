@@ -33,10 +33,12 @@ limitations under the License.
 #include "pxr/base/plug/plugin.h"
 #include "pxr/base/plug/thisPlugin.h"
 #include "pxr/imaging/pxOsd/tokens.h"
+#include "pxr/imaging/pxOsd/meshTopology.h"
 #include "pxr/imaging/glf/glew.h"
 #include "pxr/imaging/glf/uvTextureData.h"
 #include "pxr/usd/usdRender/tokens.h"
 #include "pxr/usd/usdGeom/tokens.h"
+#include "pxr/usdImaging/usdImaging/implicitSurfaceMeshUtils.h"
 #include "pxr/base/tf/envSetting.h"
 
 #include "rpr/contextHelpers.h"
@@ -48,8 +50,11 @@ limitations under the License.
 #include <RadeonProRender_Baikal.h>
 
 #include <fstream>
+#include <algorithm>
 #include <vector>
+#include <set>
 #include <mutex>
+#include <chrono>
 
 #ifdef WIN32
 #include <shlobj_core.h>
@@ -63,6 +68,12 @@ PXR_NAMESPACE_OPEN_SCOPE
 
 TF_DEFINE_ENV_SETTING(HDRPR_DISABLE_ALPHA, false,
     "Disable alpha in color AOV. All alpha values would be 1.0");
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_MAX_RESOLUTION_LOW, 1024,
+    "Maximum texture resolution in Low render quality, 0 means full resolution");
+TF_DEFINE_ENV_SETTING(HDRPR_TEXTURE_MAX_RESOLUTION_MEDIUM, 2048,
+    "Maximum texture resolution in Medium render quality, 0 means full resolution");
+TF_DEFINE_ENV_SETTING(HDRPR_ENVIRONMENT_MAX_RESOLUTION_INTERACTIVE, 0,
+    "Maximum resolution of environment light textures in interactive mode, 0 means full resolution");
 
 TF_DEFINE_PRIVATE_TOKENS(HdRprAovTokens,
     (albedo) \
@@ -85,6 +96,28 @@ bool ArchCreateDirectory(const char* path) {
 #endif
 }
 
+uint32_t GetTextureMaxResolution(RenderQualityType renderQuality) {
+    int maxResolution = 0;
+    if (renderQuality == kRenderQualityLow) {
+        maxResolution = TfGetEnvSetting(HDRPR_TEXTURE_MAX_RESOLUTION_LOW);
+    } else if (renderQuality == kRenderQualityMedium) {
+        maxResolution = TfGetEnvSetting(HDRPR_TEXTURE_MAX_RESOLUTION_MEDIUM);
+    }
+    return uint32_t(std::max(maxResolution, 0));
+}
+
+uint32_t GetEnvironmentMaxResolution(RenderQualityType renderQuality, bool isInteractive) {
+    uint32_t maxResolution = GetTextureMaxResolution(renderQuality);
+    if (isInteractive) {
+        int interactiveMaxResolution = TfGetEnvSetting(HDRPR_ENVIRONMENT_MAX_RESOLUTION_INTERACTIVE);
+        if (interactiveMaxResolution > 0 &&
+            (!maxResolution || uint32_t(interactiveMaxResolution) < maxResolution)) {
+            maxResolution = uint32_t(interactiveMaxResolution);
+        }
+    }
+    return maxResolution;
+}
+
 template <typename T>
 struct RenderSetting {
     T value;
@@ -94,10 +127,16 @@ struct RenderSetting {
 } // namespace anonymous
 
 struct HdRprApiVolume {
+    struct Grid {
+        std::unique_ptr<rpr::Grid> rprGrid;
+        // Source data of the grid, used to detect whether the grid can be reused on update
+        VtUIntArray indices;
+        VtFloatArray values;
+        GfVec3i size;
+    };
+
     std::unique_ptr<rpr::HeteroVolume> heteroVolume;
-    std::unique_ptr<rpr::Grid> albedoGrid;
-    std::unique_ptr<rpr::Grid> densityGrid;
-    std::unique_ptr<rpr::Grid> emissionGrid;
+    std::vector<Grid> grids;
     std::unique_ptr<rpr::Shape> cubeMesh;
     std::unique_ptr<HdRprApiMaterial> cubeMeshMaterial;
     GfMatrix4f transform;
@@ -105,7 +144,9 @@ struct HdRprApiVolume {
 
 struct HdRprApiEnvironmentLight {
     std::unique_ptr<rpr::EnvironmentLight> light;
-    std::unique_ptr<rpr::Image> image;
+    std::shared_ptr<rpr::Image> image;
+    /// Empty for constant color lights
+    std::string texturePath;
 
     enum {
         kDetached,
@@ -259,6 +300,7 @@ public:
             delete mesh;
             return nullptr;
         }
+        m_materialFactory->SetMeshUvs(mesh, uvs, !uvIndexes.empty() ? uvIndexes : pointIndexes, vpf);
         m_dirtyFlags |= ChangeTracker::DirtyScene;
         return mesh;
     }
@@ -281,10 +323,31 @@ public:
             delete mesh;
             return nullptr;
         }
+        m_materialFactory->CopyMeshUvs(prototype, mesh);
         m_dirtyFlags |= ChangeTracker::DirtyScene;
         return mesh;
     }
 
+    rpr::Shape* CreateUnitPrimitiveInstance(HdRprApi::UnitPrimitive primitive) {
+        if (!m_rprContext ||
+            primitive < 0 || primitive >= HdRprApi::kUnitPrimitiveCount) {
+            return nullptr;
+        }
+
+        RecursiveLockGuard rprLock(g_rprAccessMutex);
+
+        auto& prototype = m_unitPrimitives[primitive];
+        if (!prototype) {
+            prototype.reset(CreateUnitPrimitiveMesh(primitive));
+            if (!prototype) {
+                return nullptr;
+            }
+            SetMeshVisibility(prototype.get(), false);
+        }
+
+        return CreateMeshInstance(prototype.get());
+    }
+
     void SetMeshRefineLevel(rpr::Shape* mesh, const int level) {
         if (!m_rprContext) {
             return;
@@ -388,6 +451,7 @@ public:
             if (!RPR_ERROR_CHECK(m_scene->Detach(shape), "Failed to detach mesh from scene")) {
                 m_dirtyFlags |= ChangeTracker::DirtyScene;
             };
+            m_materialFactory->ReleaseMesh(shape);
             delete shape;
         }
     }
@@ -512,14 +576,22 @@ public:
         return CreateLight<rpr::SpotLight>([this, angle, softness](rpr::Status* status) {
             auto light = m_rprContext->CreateSpotLight(status);
             if (light) {
-                float outerAngle = GfDegreesToRadians(angle);
-                float innerAngle = outerAngle * (1.0f - softness);
-                RPR_ERROR_CHECK(light->SetConeShape(innerAngle, outerAngle), "Failed to set spot light cone shape");
+                SetSpotLightShape(light, angle, softness);
             }
             return light;
         });
     }
 
+    void SetSpotLightShape(rpr::SpotLight* light, float angle, float softness) {
+        RecursiveLockGuard rprLock(g_rprAccessMutex);
+
+        float outerAngle = GfDegreesToRadians(angle);
+        float innerAngle = outerAngle * (1.0f - softness);
+        if (!RPR_ERROR_CHECK(light->SetConeShape(innerAngle, outerAngle), "Failed to set spot light cone shape")) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
+    }
+
     rpr::PointLight* CreatePointLight() {
         return CreateLight<rpr::PointLight>([this](rpr::Status* status) {
             return m_rprContext->CreatePointLight(status);
@@ -527,13 +599,26 @@ public:
     }
 
     rpr::IESLight* CreateIESLight(std::string const& iesFilepath) {
-        return CreateLight<rpr::IESLight>([this, &iesFilepath](rpr::Status* status) {
+        if (!m_rprContext) {
+            return nullptr;
+        }
+
+        RecursiveLockGuard rprLock(g_rprAccessMutex);
+
+        // Fixtures usually share a handful of profiles, so profiles are read once and served by the image cache
+        auto iesData = m_imageCache->GetIesProfile(iesFilepath);
+        if (!iesData) {
+            TF_RUNTIME_ERROR("Failed to load IES profile: %s", iesFilepath.c_str());
+            return nullptr;
+        }
+
+        return CreateLight<rpr::IESLight>([this, &iesData](rpr::Status* status) {
             auto light = m_rprContext->CreateIESLight(status);
             if (light) {
                 // TODO: consider exposing it as light primitive primvar
                 constexpr int kIESImageResolution = 256;
 
-                *status = light->SetImageFromFile(iesFilepath.c_str(), kIESImageResolution, kIESImageResolution);
+                *status = light->SetImageFromIESdata(iesData->c_str(), kIESImageResolution, kIESImageResolution);
                 if (RPR_ERROR_CHECK(*status, "Failed to set IES data")) {
                     delete light;
                     light = nullptr;
@@ -554,7 +639,9 @@ public:
     void SetLightColor(Light* light, GfVec3f const& color) {
         RecursiveLockGuard rprLock(g_rprAccessMutex);
 
-        RPR_ERROR_CHECK(light->SetRadiantPower(color[0], color[1], color[2]), "Failed to set light color");
+        if (!RPR_ERROR_CHECK(light->SetRadiantPower(color[0], color[1], color[2]), "Failed to set light color")) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
     }
 
     void Release(rpr::Light* light) {
@@ -568,7 +655,7 @@ public:
         }
     }
 
-    HdRprApiEnvironmentLight* CreateEnvironmentLight(std::unique_ptr<rpr::Image>&& image, float intensity) {
+    HdRprApiEnvironmentLight* CreateEnvironmentLight(std::shared_ptr<rpr::Image> image, float intensity) {
         auto envLight = new HdRprApiEnvironmentLight;
 
         rpr::Status status;
@@ -585,6 +672,11 @@ public:
 
         if (m_rprContextMetadata.pluginType == rpr::kPluginHybrid) {
             if ((status = m_scene->SetEnvironmentLight(envLight->light.get())) == RPR_SUCCESS) {
+                // Scene has only one environment light, the previous one is replaced
+                if (m_sceneEnvironmentLight) {
+                    m_sceneEnvironmentLight->state = HdRprApiEnvironmentLight::kDetached;
+                }
+                m_sceneEnvironmentLight = envLight;
                 envLight->state = HdRprApiEnvironmentLight::kAttachedAsEnvLight;
             }
         } else {
@@ -606,16 +698,18 @@ public:
         if (envLight) {
             RecursiveLockGuard rprLock(g_rprAccessMutex);
 
-            rpr::Status status;
+            rpr::Status status = RPR_SUCCESS;
             if (envLight->state == HdRprApiEnvironmentLight::kAttachedAsEnvLight) {
                 status = m_scene->SetEnvironmentLight(nullptr);
-            } else {
+                m_sceneEnvironmentLight = nullptr;
+            } else if (envLight->state == HdRprApiEnvironmentLight::kAttachedAsLight) {
                 status = m_scene->Detach(envLight->light.get());
             }
 
             if (!RPR_ERROR_CHECK(status, "Failed to detach environment light")) {
                 m_dirtyFlags |= ChangeTracker::DirtyScene;
             }
+            m_textureEnvironmentLights.erase(envLight);
             delete envLight;
         }
     }
@@ -627,12 +721,44 @@ public:
 
         RecursiveLockGuard rprLock(g_rprAccessMutex);
 
-        auto image = std::unique_ptr<rpr::Image>(rpr::CreateImage(m_rprContext.get(), path.c_str()));
+        // Environment textures are served by the image cache, so recreating the light or switching
+        // between recently used textures does not decode them again
+        ImageCache::ImageVariant variant;
+        variant.maxResolution = m_environmentMaxResolution;
+        auto image = m_imageCache->GetImage(path, variant);
         if (!image) {
+            TF_RUNTIME_ERROR("Failed to load environment light texture: %s", path.c_str());
             return nullptr;
         }
 
-        return CreateEnvironmentLight(std::move(image), intensity);
+        auto envLight = CreateEnvironmentLight(std::move(image), intensity);
+        if (envLight) {
+            envLight->texturePath = path;
+            m_textureEnvironmentLights.insert(envLight);
+        }
+        return envLight;
+    }
+
+    void UpdateEnvironmentLightImages() {
+        auto maxResolution = GetEnvironmentMaxResolution(m_currentRenderQuality, m_isInteractiveMode);
+        if (m_environmentMaxResolution == maxResolution) {
+            return;
+        }
+        m_environmentMaxResolution = maxResolution;
+
+        ImageCache::ImageVariant variant;
+        variant.maxResolution = maxResolution;
+        for (auto envLight : m_textureEnvironmentLights) {
+            auto image = m_imageCache->GetImage(envLight->texturePath, variant);
+            if (!image || image == envLight->image) {
+                continue;
+            }
+
+            if (!RPR_ERROR_CHECK(envLight->light->SetImage(image.get()), "Failed to set env light image")) {
+                envLight->image = std::move(image);
+                m_dirtyFlags |= ChangeTracker::DirtyScene;
+            }
+        }
     }
 
     HdRprApiEnvironmentLight* CreateEnvironmentLight(GfVec3f color, float intensity) {
@@ -646,7 +772,7 @@ public:
         std::vector<std::array<float, 3>> imageData(imageSize * imageSize, backgroundColor);
 
         rpr::Status status;
-        auto image = std::unique_ptr<rpr::Image>(rpr::CreateImage(m_rprContext.get(), imageSize, imageSize, format, imageData.data(), &status));
+        auto image = std::shared_ptr<rpr::Image>(rpr::CreateImage(m_rprContext.get(), imageSize, imageSize, format, imageData.data(), &status));
         if (!image) {
             RPR_ERROR_CHECK(status, "Failed to create image", m_rprContext.get());
             return nullptr;
@@ -671,6 +797,20 @@ public:
         return m_materialFactory->CreateMaterial(MaterialAdapter.GetType(), MaterialAdapter);
     }
 
+    bool UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter const& materialAdapter) {
+        if (!m_rprContext || !material) {
+            return false;
+        }
+
+        RecursiveLockGuard rprLock(g_rprAccessMutex);
+        if (!m_materialFactory->UpdateMaterial(material, materialAdapter.GetType(), materialAdapter)) {
+            return false;
+        }
+
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+        return true;
+    }
+
     void Release(HdRprApiMaterial* material) {
         if (material) {
             RecursiveLockGuard rprLock(g_rprAccessMutex);
@@ -678,9 +818,7 @@ public:
         }
     }
 
-    HdRprApiVolume* CreateVolume(const std::vector<uint32_t>& densityGridOnIndices, const std::vector<float>& densityGridOnValueIndices, const std::vector<float>& densityGridValues,
-                                 const std::vector<uint32_t>& albedoGridOnIndices, const std::vector<float>& albedoGridOnValueIndices, const std::vector<float>& albedoGridValues,
-                                 const std::vector<uint32_t>& emissionGridOnIndices, const std::vector<float>& emissionGridOnValueIndices, const std::vector<float>& emissionGridValues,
+    HdRprApiVolume* CreateVolume(HdRprApiVolumeChannel const& density, HdRprApiVolumeChannel const& albedo, HdRprApiVolumeChannel const& emission,
                                  const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow) {
         if (!m_rprContext) {
             return nullptr;
@@ -693,55 +831,135 @@ public:
         MaterialAdapter matAdapter(EMaterialType::TRANSPERENT,
             MaterialParams{{HdPrimvarRoleTokens->color, VtValue(GfVec4f(1.0f))}});
         rprApiVolume->cubeMeshMaterial.reset(CreateMaterial(matAdapter));
-        rprApiVolume->cubeMesh.reset(CreateCubeMesh(1.0f, 1.0f, 1.0f));
-
-        rpr::Status densityGridStatus;
-        rprApiVolume->densityGrid.reset(m_rprContext->CreateGrid(gridSize[0], gridSize[1], gridSize[2], &densityGridOnIndices[0],
-            densityGridOnIndices.size() / 3, RPR_GRID_INDICES_TOPOLOGY_XYZ_U32,
-            &densityGridOnValueIndices[0], densityGridOnValueIndices.size() * sizeof(densityGridOnValueIndices[0]), 0, &densityGridStatus));
-
-        rpr::Status albedoGridStatus;
-        rprApiVolume->albedoGrid.reset(m_rprContext->CreateGrid(gridSize[0], gridSize[1], gridSize[2], &albedoGridOnIndices[0],
-            albedoGridOnIndices.size() / 3, RPR_GRID_INDICES_TOPOLOGY_XYZ_U32,
-            &albedoGridOnValueIndices[0], albedoGridOnValueIndices.size() * sizeof(albedoGridOnValueIndices[0]), 0, &albedoGridStatus));
-
-        rpr::Status emissionGridStatus;
-        rprApiVolume->emissionGrid.reset(m_rprContext->CreateGrid(gridSize[0], gridSize[1], gridSize[2], &emissionGridOnIndices[0],
-            emissionGridOnIndices.size() / 3, RPR_GRID_INDICES_TOPOLOGY_XYZ_U32,
-            &emissionGridOnValueIndices[0], emissionGridOnValueIndices.size() * sizeof(emissionGridOnValueIndices[0]), 0, &emissionGridStatus));
+        rprApiVolume->cubeMesh.reset(CreateUnitPrimitiveInstance(HdRprApi::kUnitCube));
 
         rpr::Status heteroVolumeStatus;
         rprApiVolume->heteroVolume.reset(m_rprContext->CreateHeteroVolume(&heteroVolumeStatus));
 
-        if (!rprApiVolume->densityGrid || !rprApiVolume->albedoGrid || !rprApiVolume->emissionGrid ||
-            !rprApiVolume->cubeMeshMaterial || !rprApiVolume->cubeMesh ||
+        if (!rprApiVolume->cubeMeshMaterial || !rprApiVolume->cubeMesh ||
             !rprApiVolume->heteroVolume ||
-            RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetDensityGrid(rprApiVolume->densityGrid.get()), "Failed to set density hetero volume grid") ||
-            RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetDensityLookup(densityGridValues.data(), densityGridValues.size() / 3), "Failed to set density volume lookup values") ||
-            RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetAlbedoGrid(rprApiVolume->albedoGrid.get()), "Failed to set albedo hetero volume grid") ||
-            RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetAlbedoLookup(albedoGridValues.data(), albedoGridValues.size() / 3), "Failed to set albedo volume lookup values") ||
-            RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetEmissionGrid(rprApiVolume->emissionGrid.get()), "Failed to set emission hetero volume grid") ||
-            RPR_ERROR_CHECK(rprApiVolume->heteroVolume->SetEmissionLookup(emissionGridValues.data(), emissionGridValues.size() / 3), "Failed to set emission volume lookup values") ||
+            !UpdateVolume(rprApiVolume, density, albedo, emission, gridSize, voxelSize, gridBBLow) ||
             RPR_ERROR_CHECK(rprApiVolume->cubeMesh->SetHeteroVolume(rprApiVolume->heteroVolume.get()), "Failed to set hetero volume to mesh") ||
             RPR_ERROR_CHECK(m_scene->Attach(rprApiVolume->heteroVolume.get()), "Failed attach hetero volume")) {
 
-            RPR_ERROR_CHECK(densityGridStatus, "Failed to create density grid");
-            RPR_ERROR_CHECK(albedoGridStatus, "Failed to create albedo grid");
-            RPR_ERROR_CHECK(emissionGridStatus, "Failed to create emission grid");
             RPR_ERROR_CHECK(heteroVolumeStatus, "Failed to create hetero volume");
+            Release(rprApiVolume->cubeMesh.release());
+            m_materialFactory->Release(rprApiVolume->cubeMeshMaterial.release());
             delete rprApiVolume;
             return nullptr;
         }
 
         SetMeshMaterial(rprApiVolume->cubeMesh.get(), rprApiVolume->cubeMeshMaterial.get(), true, false);
 
-        rprApiVolume->transform = GfMatrix4f(1.0f);
-        rprApiVolume->transform.SetScale(GfCompMult(voxelSize, gridSize));
-        rprApiVolume->transform.SetTranslateOnly(GfCompMult(voxelSize, GfVec3f(gridSize)) / 2.0f + gridBBLow);
-
         return rprApiVolume;
     }
 
+    bool UpdateVolume(HdRprApiVolume* volume, HdRprApiVolumeChannel const& density, HdRprApiVolumeChannel const& albedo, HdRprApiVolumeChannel const& emission,
+                      const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow) {
+        RecursiveLockGuard rprLock(g_rprAccessMutex);
+
+        constexpr int kNumChannels = 3;
+        HdRprApiVolumeChannel const* channels[kNumChannels] = {&density, &albedo, &emission};
+        rpr::Grid* channelGrids[kNumChannels] = {};
+
+        auto isGridOf = [&gridSize](HdRprApiVolume::Grid const& grid, HdRprApiVolumeChannel const* channel) {
+            return grid.rprGrid &&
+                grid.size == gridSize &&
+                grid.indices.cdata() == channel->indices.cdata() &&
+                grid.values.cdata() == channel->values.cdata();
+        };
+
+        // Create one grid per unique data: channels that reference the same arrays share the grid,
+        // grids of the previous update are reused when channel data did not change
+        std::vector<HdRprApiVolume::Grid> grids;
+        rpr::Grid* anyGrid = nullptr;
+        for (int i = 0; i < kNumChannels; ++i) {
+            auto channel = channels[i];
+            if (channel->IsConstant()) {
+                continue;
+            }
+
+            for (auto& grid : grids) {
+                if (isGridOf(grid, channel)) {
+                    channelGrids[i] = grid.rprGrid.get();
+                    break;
+                }
+            }
+
+            if (!channelGrids[i]) {
+                for (auto& grid : volume->grids) {
+                    if (isGridOf(grid, channel)) {
+                        channelGrids[i] = grid.rprGrid.get();
+                        grids.push_back(std::move(grid));
+                        break;
+                    }
+                }
+            }
+
+            if (!channelGrids[i]) {
+                rpr::Status status;
+                auto rprGrid = m_rprContext->CreateGrid(gridSize[0], gridSize[1], gridSize[2], channel->indices.cdata(),
+                    channel->indices.size() / 3, RPR_GRID_INDICES_TOPOLOGY_XYZ_U32,
+                    channel->values.cdata(), channel->values.size() * sizeof(float), 0, &status);
+                if (!rprGrid) {
+                    RPR_ERROR_CHECK(status, "Failed to create volume grid");
+                    return false;
+                }
+
+                HdRprApiVolume::Grid grid;
+                grid.rprGrid.reset(rprGrid);
+                grid.indices = channel->indices;
+                grid.values = channel->values;
+                grid.size = gridSize;
+                grids.push_back(std::move(grid));
+                channelGrids[i] = rprGrid;
+            }
+
+            anyGrid = channelGrids[i];
+        }
+
+        if (!anyGrid) {
+            TF_RUNTIME_ERROR("Failed to create volume: all channels are constant");
+            return false;
+        }
+
+        // Constant channels reuse any existing grid with the lookup table where all entries are equal
+        VtFloatArray channelLookups[kNumChannels];
+        for (int i = 0; i < kNumChannels; ++i) {
+            auto& lookup = channels[i]->lookup;
+            if (lookup.size() < 3) {
+                TF_RUNTIME_ERROR("Failed to create volume: invalid lookup table");
+                return false;
+            }
+
+            if (channelGrids[i]) {
+                channelLookups[i] = lookup;
+            } else {
+                channelGrids[i] = anyGrid;
+                channelLookups[i] = VtFloatArray{lookup[0], lookup[1], lookup[2], lookup[0], lookup[1], lookup[2]};
+            }
+        }
+
+        if (RPR_ERROR_CHECK(volume->heteroVolume->SetDensityGrid(channelGrids[0]), "Failed to set density hetero volume grid") ||
+            RPR_ERROR_CHECK(volume->heteroVolume->SetDensityLookup(channelLookups[0].cdata(), channelLookups[0].size() / 3), "Failed to set density volume lookup values") ||
+            RPR_ERROR_CHECK(volume->heteroVolume->SetAlbedoGrid(channelGrids[1]), "Failed to set albedo hetero volume grid") ||
+            RPR_ERROR_CHECK(volume->heteroVolume->SetAlbedoLookup(channelLookups[1].cdata(), channelLookups[1].size() / 3), "Failed to set albedo volume lookup values") ||
+            RPR_ERROR_CHECK(volume->heteroVolume->SetEmissionGrid(channelGrids[2]), "Failed to set emission hetero volume grid") ||
+            RPR_ERROR_CHECK(volume->heteroVolume->SetEmissionLookup(channelLookups[2].cdata(), channelLookups[2].size() / 3), "Failed to set emission volume lookup values")) {
+            return false;
+        }
+
+        // Grids that are not used anymore are released only after the hetero volume stops referencing them
+        volume->grids = std::move(grids);
+
+        volume->transform = GfMatrix4f(1.0f);
+        volume->transform.SetScale(GfCompMult(voxelSize, gridSize));
+        volume->transform.SetTranslateOnly(GfCompMult(voxelSize, GfVec3f(gridSize)) / 2.0f + gridBBLow);
+
+        m_dirtyFlags |= ChangeTracker::DirtyScene;
+        return true;
+    }
+
     void SetTransform(HdRprApiVolume* volume, GfMatrix4f const& transform) {
         auto t = transform * volume->transform;
         RPR_ERROR_CHECK(volume->cubeMesh->SetTransform(t.data(), false), "Failed to set cubeMesh transform");
@@ -754,6 +972,9 @@ public:
             RecursiveLockGuard rprLock(g_rprAccessMutex);
 
             m_scene->Detach(volume->heteroVolume.get());
+            Release(volume->cubeMesh.release());
+            // Material might be shared with other volumes
+            m_materialFactory->Release(volume->cubeMeshMaterial.release());
             delete volume;
 
             m_dirtyFlags |= ChangeTracker::DirtyScene;
@@ -834,6 +1055,9 @@ public:
     void Update() {
         RecursiveLockGuard rprLock(g_rprAccessMutex);
 
+        if (m_materialFactory->CommitLoadedTextures()) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
         m_imageCache->GarbageCollectIfNeeded();
 
         auto rprRenderParam = static_cast<HdRprRenderParam*>(m_delegate->GetRenderParam());
@@ -844,8 +1068,8 @@ public:
                 const GfVec3f k_defaultLightColor(0.5f, 0.5f, 0.5f);
                 m_defaultLightObject.reset(CreateEnvironmentLight(k_defaultLightColor, 1.f));
             }
-        } else {
-            m_defaultLightObject = nullptr;
+        } else if (m_defaultLightObject) {
+            Release(m_defaultLightObject.release());
         }
 
         bool clearAovs = false;
@@ -905,6 +1129,10 @@ public:
             UpdateSettings(*config);
             config->ResetDirty();
         }
+        if (m_materialFactory->SetTextureMaxResolution(GetTextureMaxResolution(m_currentRenderQuality))) {
+            m_dirtyFlags |= ChangeTracker::DirtyScene;
+        }
+        UpdateEnvironmentLightImages();
         UpdateCamera(aspectRatioPolicy, instantaneousShutter);
         UpdateAovs(rprRenderParam, enableDenoise, clearAovs);
 
@@ -979,6 +1207,7 @@ public:
         }
 
         m_currentRenderQuality = preferences.GetRenderQuality();
+        m_isInteractiveMode = preferences.GetInteractiveMode();
 
         if (m_rprContextMetadata.pluginType == rpr::kPluginTahoe) {
             UpdateTahoeSettings(preferences, force);
@@ -1196,6 +1425,17 @@ public:
                 break;
             }
 
+            // Commits are driven by the image loader so that the lock is not taken while nothing was decoded
+            if (m_imageCache->WaitForLoadedImages(std::chrono::steady_clock::duration::zero())) {
+                CommitLoadedTextures();
+            }
+            if (IsSamplingConverged()) {
+                // Only textures that are still loading keep the render going, do not waste samples.
+                // The wait is interrupted by AbortRender when the render is stopped
+                m_imageCache->WaitForLoadedImages(std::chrono::seconds(1));
+                continue;
+            }
+
             if (m_rprContextMetadata.pluginType != rpr::kPluginHybrid) {
                 RPR_ERROR_CHECK(m_rprContext->SetParameter(RPR_CONTEXT_FRAMECOUNT, m_iter), "Failed to set framecount");
             }
@@ -1311,6 +1551,9 @@ Don't show this message again?
         if (m_rprContext) {
             RPR_ERROR_CHECK(m_rprContext->AbortRender(), "Failed to abort render");
         }
+        if (m_imageCache) {
+            m_imageCache->WakeUp();
+        }
     }
 
     int GetNumCompletedSamples() const {
@@ -1341,13 +1584,38 @@ Don't show this message again?
     }
 
     bool IsConverged() const {
+        if (m_materialFactory && m_materialFactory->HasPendingTextures()) {
+            return false;
+        }
+
+        return IsSamplingConverged();
+    }
+
+    bool IsSamplingConverged() const {
         if (m_currentRenderQuality < kRenderQualityHigh) {
-            return m_iter == 1;
+            return m_iter >= 1;
         }
 
         return m_iter >= m_maxSamples || m_activePixels == 0;
     }
 
+    void CommitLoadedTextures() {
+        RecursiveLockGuard rprLock(g_rprAccessMutex);
+
+        if (!m_materialFactory->CommitLoadedTextures()) {
+            return;
+        }
+
+        // Restart accumulation with the real textures
+        for (auto& aovEntry : m_aovRegistry) {
+            if (auto aov = aovEntry.second.lock()) {
+                aov->Clear();
+            }
+        }
+        m_iter = 0;
+        m_activePixels = -1;
+    }
+
     bool IsGlInteropEnabled() const {
         return m_rprContext && m_rprContextMetadata.isGlInteropEnabled;
     }
@@ -1364,6 +1632,10 @@ Don't show this message again?
         return m_currentRenderQuality;
     }
 
+    bool IsInteractive() const {
+        return m_isInteractiveMode || m_currentRenderQuality < kRenderQualityFull;
+    }
+
 private:
     void InitRpr() {
         RenderQualityType renderQuality;
@@ -1392,8 +1664,10 @@ private:
             UpdateSettings(*config, true);
         }
 
-        m_imageCache.reset(new ImageCache(m_rprContext.get()));
+        m_imageCache.reset(new ImageCache(m_rprContext.get(), cachePath + ARCH_PATH_SEP + "textures"));
         m_materialFactory.reset(new RprMaterialFactory(m_imageCache.get()));
+        m_materialFactory->SetTextureMaxResolution(GetTextureMaxResolution(m_currentRenderQuality));
+        m_environmentMaxResolution = GetEnvironmentMaxResolution(m_currentRenderQuality, m_isInteractiveMode);
     }
 
     bool ValidateRifModels(std::string const& modelsPath) {
@@ -1560,6 +1834,71 @@ private:
         }
     }
 
+    rpr::Shape* CreateUnitPrimitiveMesh(HdRprApi::UnitPrimitive primitive) {
+        if (primitive == HdRprApi::kUnitCube) {
+            return CreateCubeMesh(1.0f, 1.0f, 1.0f);
+        } else if (primitive == HdRprApi::kUnitDisk) {
+            return CreateDiskMesh();
+        } else if (primitive == HdRprApi::kUnitRect) {
+            constexpr float kHalfSize = 0.5f;
+            VtVec3fArray points = {
+                GfVec3f(kHalfSize, kHalfSize, 0.0f),
+                GfVec3f(kHalfSize, -kHalfSize, 0.0f),
+                GfVec3f(-kHalfSize, -kHalfSize, 0.0f),
+                GfVec3f(-kHalfSize, kHalfSize, 0.0f),
+            };
+            VtIntArray pointIndices = {
+                0, 1, 2,
+                0, 2, 3
+            };
+            VtIntArray vpf(pointIndices.size() / 3, 3);
+
+            return CreateMesh(points, pointIndices, VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), vpf);
+        } else if (primitive == HdRprApi::kUnitSphere) {
+            auto& topology = UsdImagingGetUnitSphereMeshTopology();
+            auto& points = UsdImagingGetUnitSphereMeshPoints();
+
+            return CreateMesh(points, topology.GetFaceVertexIndices(), VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), topology.GetFaceVertexCounts(), topology.GetOrientation());
+        } else if (primitive == HdRprApi::kUnitCylinder) {
+            auto& topology = UsdImagingGetUnitCylinderMeshTopology();
+            auto& points = UsdImagingGetUnitCylinderMeshPoints();
+
+            return CreateMesh(points, topology.GetFaceVertexIndices(), VtVec3fArray(), VtIntArray(), VtVec2fArray(), VtIntArray(), topology.GetFaceVertexCounts(), topology.GetOrientation());
+        }
+
+        return nullptr;
+    }
+
+    rpr::Shape* CreateDiskMesh() {
+        constexpr uint32_t kDiskVertexCount = 32;
+        constexpr float kRadius = 0.5f;
+
+        VtVec3fArray points;
+        VtIntArray pointIndices;
+        VtVec3fArray normals(1, GfVec3f(0.0f, 0.0f, -1.0f));
+        VtIntArray normalIndices(kDiskVertexCount * 3, 0);
+        VtIntArray vpf(kDiskVertexCount, 3);
+
+        points.reserve(kDiskVertexCount + 1);
+        pointIndices.reserve(kDiskVertexCount * 3);
+
+        const double step = M_PI * 2.0 / kDiskVertexCount;
+        for (int i = 0; i < kDiskVertexCount; ++i) {
+            double angle = step * i;
+            points.push_back(GfVec3f(kRadius * cos(angle), kRadius * sin(angle), 0.0f));
+        }
+        const int centerPointIndex = points.size();
+        points.push_back(GfVec3f(0.0f));
+
+        for (int i = 0; i < kDiskVertexCount; ++i) {
+            pointIndices.push_back(i);
+            pointIndices.push_back((i + 1) % kDiskVertexCount);
+            pointIndices.push_back(centerPointIndex);
+        }
+
+        return CreateMesh(points, pointIndices, normals, normalIndices, VtVec2fArray(), VtIntArray(), vpf);
+    }
+
     rpr::Shape* CreateCubeMesh(float width, float height, float depth) {
         constexpr const size_t cubeVertexCount = 24;
         constexpr const size_t cubeNormalCount = 24;
@@ -1882,6 +2221,9 @@ private:
     std::unique_ptr<ImageCache> m_imageCache;
     std::unique_ptr<RprMaterialFactory> m_materialFactory;
 
+    // Prototypes of light shapes and volume bounds, created on first use
+    std::unique_ptr<rpr::Shape> m_unitPrimitives[HdRprApi::kUnitPrimitiveCount];
+
     std::map<TfToken, std::weak_ptr<HdRprApiAov>> m_aovRegistry;
     std::map<TfToken, std::shared_ptr<HdRprApiAov>> m_boundAovs;
     std::map<TfToken, std::shared_ptr<HdRprApiAov>> m_internalAovs;
@@ -1892,12 +2234,17 @@ private:
     HdRprCamera const* m_hdCamera;
 
     std::unique_ptr<HdRprApiEnvironmentLight> m_defaultLightObject;
+    std::set<HdRprApiEnvironmentLight*> m_textureEnvironmentLights;
+    HdRprApiEnvironmentLight* m_sceneEnvironmentLight = nullptr;
+    uint32_t m_environmentMaxResolution = 0;
 
     int m_iter = 0;
     int m_activePixels = -1;
     int m_maxSamples = 0;
     float m_varianceThreshold = 0.0f;
-    RenderQualityType m_currentRenderQuality = kRenderQualityFull;
+    // Updated by the render thread, read while the scene is synced
+    std::atomic<RenderQualityType> m_currentRenderQuality{kRenderQualityFull};
+    bool m_isInteractiveMode = false;
 
     enum State {
         kStateUninitialized,
@@ -1932,6 +2279,11 @@ rpr::Shape* HdRprApi::CreateMeshInstance(rpr::Shape* prototypeMesh) {
     return m_impl->CreateMeshInstance(prototypeMesh);
 }
 
+rpr::Shape* HdRprApi::CreateUnitPrimitiveInstance(UnitPrimitive primitive) {
+    m_impl->InitIfNeeded();
+    return m_impl->CreateUnitPrimitiveInstance(primitive);
+}
+
 HdRprApiEnvironmentLight* HdRprApi::CreateEnvironmentLight(GfVec3f color, float intensity) {
     m_impl->InitIfNeeded();
     return m_impl->CreateEnvironmentLight(color, intensity);
@@ -1974,6 +2326,10 @@ void HdRprApi::SetDirectionalLightAttributes(rpr::DirectionalLight* directionalL
     m_impl->SetDirectionalLightAttributes(directionalLight, color, shadowSoftnessAngle);
 }
 
+void HdRprApi::SetSpotLightShape(rpr::SpotLight* light, float angle, float softness) {
+    m_impl->SetSpotLightShape(light, angle, softness);
+}
+
 void HdRprApi::SetLightColor(rpr::SpotLight* light, GfVec3f const& color) {
     m_impl->SetLightColor(light, color);
 }
@@ -1986,20 +2342,13 @@ void HdRprApi::SetLightColor(rpr::IESLight* light, GfVec3f const& color) {
     m_impl->SetLightColor(light, color);
 }
 
-HdRprApiVolume* HdRprApi::CreateVolume(
-    const std::vector<uint32_t>& densityGridOnIndices, const std::vector<float>& densityGridOnValueIndices, const std::vector<float>& densityGridValues,
-    const std::vector<uint32_t>& colorGridOnIndices, const std::vector<float>& colorGridOnValueIndices, const std::vector<float>& colorGridValues,
-    const std::vector<uint32_t>& emissiveGridOnIndices, const std::vector<float>& emissiveGridOnValueIndices, const std::vector<float>& emissiveGridValues,
-    const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow) {
+HdRprApiVolume* HdRprApi::CreateVolume(HdRprApiVolumeChannel const& density, HdRprApiVolumeChannel const& albedo, HdRprApiVolumeChannel const& emission,
+                                       const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow) {
     m_impl->InitIfNeeded();
-    return m_impl->CreateVolume(
-        densityGridOnIndices, densityGridOnValueIndices, densityGridValues,
-        colorGridOnIndices, colorGridOnValueIndices, colorGridValues,
-        emissiveGridOnIndices, emissiveGridOnValueIndices, emissiveGridValues,
-        gridSize, voxelSize, gridBBLow);
+    return m_impl->CreateVolume(density, albedo, emission, gridSize, voxelSize, gridBBLow);
 }
 
-HdRprApiMaterial* HdRprApi::CreateMaterial(MaterialAdapter& MaterialAdapter) {
+HdRprApiMaterial* HdRprApi::CreateMaterial(MaterialAdapter const& MaterialAdapter) {
     m_impl->InitIfNeeded();
     return m_impl->CreateMaterial(MaterialAdapter);
 }
@@ -2036,10 +2385,19 @@ void HdRprApi::Release(HdRprApiEnvironmentLight* envLight) {
     m_impl->Release(envLight);
 }
 
+bool HdRprApi::UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter const& materialAdapter) {
+    return m_impl->UpdateMaterial(material, materialAdapter);
+}
+
 void HdRprApi::Release(HdRprApiMaterial* material) {
     m_impl->Release(material);
 }
 
+bool HdRprApi::UpdateVolume(HdRprApiVolume* volume, HdRprApiVolumeChannel const& density, HdRprApiVolumeChannel const& albedo, HdRprApiVolumeChannel const& emission,
+                            const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow) {
+    return m_impl->UpdateVolume(volume, density, albedo, emission, gridSize, voxelSize, gridBBLow);
+}
+
 void HdRprApi::Release(HdRprApiVolume* volume) {
     m_impl->Release(volume);
 }
@@ -2126,6 +2484,10 @@ int HdRprApi::GetCurrentRenderQuality() const {
     return m_impl->GetCurrentRenderQuality();
 }
 
+bool HdRprApi::IsInteractive() const {
+    return m_impl->IsInteractive();
+}
+
 std::string HdRprApi::GetAppDataPath() {
     auto appDataPath = []() -> std::string {
 #ifdef WIN32
@@ -19,6 +19,7 @@ limitations under the License.
 #include "pxr/base/gf/vec2i.h"
 #include "pxr/base/gf/vec3f.h"
 #include "pxr/base/vt/array.h"
+#include "pxr/base/vt/types.h"
 #include "pxr/base/gf/matrix4f.h"
 #include "pxr/base/gf/quaternion.h"
 #include "pxr/base/tf/staticTokens.h"
@@ -44,6 +45,20 @@ struct HdRprApiVolume;
 struct HdRprApiMaterial;
 struct HdRprApiEnvironmentLight;
 
+/// Single channel (density, albedo or emission) of a volume.
+/// Channels that share the same indices and values arrays share one RPR grid.
+/// Channel without values is constant, its value is the first entry of the lookup table.
+struct HdRprApiVolumeChannel {
+    /// xyz triplets of active voxel coordinates
+    VtUIntArray indices;
+    /// Per-voxel lookup coordinates in [0, 1] range
+    VtFloatArray values;
+    /// RGB triplets
+    VtFloatArray lookup;
+
+    bool IsConstant() const { return values.empty(); }
+};
+
 template <typename T, typename... Args>
 std::unique_ptr<T> make_unique(Args&&... args) {
     return std::unique_ptr<T>(new T(std::forward<Args>(args)...));
@@ -65,24 +80,42 @@ public:
     rpr::PointLight* CreatePointLight();
 
     void SetDirectionalLightAttributes(rpr::DirectionalLight* light, GfVec3f const& color, float shadowSoftnessAngle);
+    void SetSpotLightShape(rpr::SpotLight* light, float angle, float softness);
     void SetLightColor(rpr::SpotLight* light, GfVec3f const& color);
     void SetLightColor(rpr::PointLight* light, GfVec3f const& color);
     void SetLightColor(rpr::IESLight* light, GfVec3f const& color);
 
     void Release(rpr::Light* light);
 
-    HdRprApiVolume* CreateVolume(const std::vector<uint32_t>& densityGridOnIndices, const std::vector<float>& densityGridOnValueIndices, const std::vector<float>& densityGridValues,
-                                const std::vector<uint32_t>& colorGridOnIndices, const std::vector<float>& colorGridOnValueIndices, const std::vector<float>& colorGridValues,
-                                const std::vector<uint32_t>& emissiveGridOnIndices, const std::vector<float>& emissiveGridOnValueIndices, const std::vector<float>& emissiveGridValues,
-                                const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow);
+    HdRprApiVolume* CreateVolume(HdRprApiVolumeChannel const& density, HdRprApiVolumeChannel const& albedo, HdRprApiVolumeChannel const& emission,
+                                 const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow);
+    /// Replaces channels of the volume. Grids of channels whose arrays did not change are reused.
+    /// Transform should be set again after the update
+    bool UpdateVolume(HdRprApiVolume* volume, HdRprApiVolumeChannel const& density, HdRprApiVolumeChannel const& albedo, HdRprApiVolumeChannel const& emission,
+                      const GfVec3i& gridSize, const GfVec3f& voxelSize, const GfVec3f& gridBBLow);
     void SetTransform(HdRprApiVolume* volume, GfMatrix4f const& transform);
     void Release(HdRprApiVolume* volume);
 
-    HdRprApiMaterial* CreateMaterial(MaterialAdapter& materialAdapter);
+    HdRprApiMaterial* CreateMaterial(MaterialAdapter const& materialAdapter);
+    /// Updates parameters of the material in place. Returns false if the material should be recreated instead
+    bool UpdateMaterial(HdRprApiMaterial* material, MaterialAdapter const& materialAdapter);
     void Release(HdRprApiMaterial* material);
 
     rpr::Shape* CreateMesh(const VtVec3fArray& points, const VtIntArray& pointIndexes, const VtVec3fArray& normals, const VtIntArray& normalIndexes, const VtVec2fArray& uv, const VtIntArray& uvIndexes, const VtIntArray& vpf, TfToken const& polygonWinding);
     rpr::Shape* CreateMeshInstance(rpr::Shape* prototypeMesh);
+
+    /// Primitives of unit size centered at the origin. Disk and rect lie in XY plane, cylinder is aligned with Z axis
+    enum UnitPrimitive {
+        kUnitCube,
+        kUnitDisk,
+        kUnitRect,
+        kUnitSphere,
+        kUnitCylinder,
+        kUnitPrimitiveCount
+    };
+    /// Creates an instance of the unit primitive. Prototypes are created once per context and are not rendered themselves
+    rpr::Shape* CreateUnitPrimitiveInstance(UnitPrimitive primitive);
+
     void SetMeshRefineLevel(rpr::Shape* mesh, int level);
     void SetMeshVertexInterpolationRule(rpr::Shape* mesh, TfToken boundaryInterpolation);
     void SetMeshMaterial(rpr::Shape* mesh, HdRprApiMaterial const* material, bool doublesided, bool displacementEnabled);
@@ -121,6 +154,8 @@ public:
     bool IsAovFormatConversionAvailable() const;
     bool IsArbitraryShapedLightSupported() const;
     int GetCurrentRenderQuality() const;
+    /// Whether the render is a preview: interactive mode is enabled or render quality is reduced
+    bool IsInteractive() const;
 
     static std::string GetAppDataPath();
     static std::string GetCachePath();
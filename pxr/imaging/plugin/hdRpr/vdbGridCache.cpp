@@ -0,0 +1,486 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#include "vdbGridCache.h"
+
+#include "houdini/openvdb.h"
+
+#include "pxr/base/arch/fileSystem.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/tf/fileUtils.h"
+#include "pxr/base/tf/stringUtils.h"
+
+#include <openvdb/tree/LeafManager.h>
+#include <openvdb/tools/GridTransformer.h>
+#include <openvdb/tools/Filter.h>
+
+#include <limits>
+#include <cctype>
+#include <cstdlib>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_ENV_SETTING(HDRPR_VDB_CACHE_SIZE_MB, 2048,
+    "Maximum amount of memory in megabytes that can be used to keep OpenVDB grids and extracted volume data cached");
+TF_DEFINE_ENV_SETTING(HDRPR_VDB_PREFETCH_FRAMES, 0,
+    "Number of frames of VDB sequence to load ahead of the current frame in background. 0 disables prefetching");
+TF_DEFINE_ENV_SETTING(HDRPR_VDB_PREFETCH_SIZE_MB, 1024,
+    "Prefetching of VDB sequence frames stops when VDB cache memory usage reaches this limit in megabytes");
+
+bool IsHoudiniGridPath(std::string const& path) {
+    return path.compare(0, sizeof("op:") - 1, "op:") == 0;
+}
+
+namespace {
+
+/// Extracts active values of the grid into flat index (xyz triplets) and value arrays.
+/// Leaves are processed in parallel: active voxels are counted per leaf, converted to
+/// offsets with a prefix sum and then each leaf writes directly into presized buffers.
+/// Active tiles are appended after the leaf voxels, one entry per tile at its origin.
+/// Min and max of the values are computed in the same pass.
+void ReadFloatGrid(openvdb::FloatGrid const* grid, const openvdb::Coord& coordOffset, VdbGridCache::FloatGridData* outData) {
+    using FloatTree = openvdb::FloatGrid::TreeType;
+    using FloatLeaf = FloatTree::LeafNodeType;
+
+    auto& outIndices = outData->indices;
+    auto& outValues = outData->values;
+
+    auto& tree = grid->tree();
+    openvdb::tree::LeafManager<const FloatTree> leafManager(tree);
+    const size_t numLeaves = leafManager.leafCount();
+
+    std::vector<size_t> leafOffsets(numLeaves + 1, 0);
+    leafManager.foreach([&leafOffsets](FloatLeaf const& leaf, size_t leafIndex) {
+        leafOffsets[leafIndex + 1] = leaf.onVoxelCount();
+    });
+    for (size_t i = 0; i < numLeaves; ++i) {
+        leafOffsets[i + 1] += leafOffsets[i];
+    }
+    const size_t numLeafVoxels = leafOffsets[numLeaves];
+
+    // Active tiles are not stored in leaves, they are few and are read separately
+    std::vector<std::pair<openvdb::Coord, float>> tiles;
+    {
+        auto tileIter = tree.cbeginValueOn();
+        tileIter.setMaxDepth(FloatTree::ValueOnCIter::LEAF_DEPTH - 1);
+        for (; tileIter; ++tileIter) {
+            tiles.emplace_back(tileIter.getCoord(), *tileIter);
+        }
+    }
+
+    outIndices.resize((numLeafVoxels + tiles.size()) * 3);
+    outValues.resize(numLeafVoxels + tiles.size());
+    uint32_t* indicesData = outIndices.data();
+    float* valuesData = outValues.data();
+
+    std::vector<float> leafMinValues(numLeaves, std::numeric_limits<float>::max());
+    std::vector<float> leafMaxValues(numLeaves, std::numeric_limits<float>::lowest());
+
+    leafManager.foreach([&](FloatLeaf const& leaf, size_t leafIndex) {
+        size_t offset = leafOffsets[leafIndex];
+        uint32_t* indices = indicesData + offset * 3;
+        float* values = valuesData + offset;
+
+        float minValue = leafMinValues[leafIndex];
+        float maxValue = leafMaxValues[leafIndex];
+        for (auto iter = leaf.cbeginValueOn(); iter; ++iter) {
+            openvdb::Coord coord = iter.getCoord() + coordOffset;
+            *indices++ = coord.x();
+            *indices++ = coord.y();
+            *indices++ = coord.z();
+
+            float value = *iter;
+            minValue = std::min(minValue, value);
+            maxValue = std::max(maxValue, value);
+            *values++ = value;
+        }
+        leafMinValues[leafIndex] = minValue;
+        leafMaxValues[leafIndex] = maxValue;
+    });
+
+    float minValue = std::numeric_limits<float>::max();
+    float maxValue = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < numLeaves; ++i) {
+        minValue = std::min(minValue, leafMinValues[i]);
+        maxValue = std::max(maxValue, leafMaxValues[i]);
+    }
+
+    uint32_t* indices = indicesData + numLeafVoxels * 3;
+    float* values = valuesData + numLeafVoxels;
+    for (auto& tile : tiles) {
+        openvdb::Coord coord = tile.first + coordOffset;
+        *indices++ = coord.x();
+        *indices++ = coord.y();
+        *indices++ = coord.z();
+
+        float value = tile.second;
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+        *values++ = value;
+    }
+
+    if (outValues.empty()) {
+        minValue = maxValue = 0.0f;
+    }
+    outData->minValue = minValue;
+    outData->maxValue = maxValue;
+}
+
+/// Resamples the grid to voxels downsampleFactor times larger along each axis
+openvdb::FloatGrid::Ptr DownsampleFloatGrid(openvdb::FloatGrid const& grid, int downsampleFactor) {
+    auto transform = grid.transform().copy();
+    transform->preScale(double(downsampleFactor));
+
+    // Resampling interpolates only the nearest source voxels,
+    // average the voxels each downsampled voxel covers first so that thin features do not alias
+    auto averagedGrid = grid.deepCopy();
+    openvdb::tools::Filter<openvdb::FloatGrid> filter(*averagedGrid);
+    filter.mean(std::max(downsampleFactor / 2, 1));
+
+    auto downsampledGrid = openvdb::FloatGrid::create(grid.background());
+    downsampledGrid->setTransform(transform);
+    downsampledGrid->setGridClass(grid.getGridClass());
+    downsampledGrid->setName(grid.getName());
+    openvdb::tools::resampleToMatch<openvdb::tools::BoxSampler>(*averagedGrid, *downsampledGrid);
+    return downsampledGrid;
+}
+
+/// Returns paths of the next numFrames frames that exist on disk.
+/// Frame number is the last group of digits in the file name, zero padding is preserved
+std::vector<std::string> GetNextSequenceFramePaths(std::string const& path, int numFrames) {
+    std::vector<std::string> framePaths;
+
+    size_t fileNameBegin = path.find_last_of("/\\");
+    fileNameBegin = (fileNameBegin == std::string::npos) ? 0 : fileNameBegin + 1;
+
+    size_t frameEnd = path.size();
+    while (frameEnd > fileNameBegin && !std::isdigit(path[frameEnd - 1])) {
+        --frameEnd;
+    }
+    size_t frameBegin = frameEnd;
+    while (frameBegin > fileNameBegin && std::isdigit(path[frameBegin - 1])) {
+        --frameBegin;
+    }
+    if (frameBegin == frameEnd) {
+        return framePaths;
+    }
+
+    auto prefix = path.substr(0, frameBegin);
+    auto suffix = path.substr(frameEnd);
+    int padding = int(frameEnd - frameBegin);
+    long frame = std::strtol(path.c_str() + frameBegin, nullptr, 10);
+
+    for (int i = 1; i <= numFrames; ++i) {
+        auto framePath = TfStringPrintf("%s%0*ld%s", prefix.c_str(), padding, frame + i, suffix.c_str());
+        if (!TfIsFile(framePath)) {
+            break;
+        }
+        framePaths.push_back(std::move(framePath));
+    }
+
+    return framePaths;
+}
+
+} // namespace anonymous
+
+size_t VdbGridCache::FloatGridData::GetMemoryUsage() const {
+    return indices.size() * sizeof(uint32_t) + values.size() * sizeof(float);
+}
+
+VdbGridCache& VdbGridCache::GetInstance() {
+    // Never destroyed: its dispatcher must not run into TBB during static destruction.
+    // Prefetch tasks are stopped by StopPrefetching when the last render delegate is destroyed
+    static VdbGridCache* instance = new VdbGridCache;
+    return *instance;
+}
+
+VdbGridCache::VdbGridCache() {
+    openvdb::initialize();
+    m_memoryBudget = size_t(std::max(TfGetEnvSetting(HDRPR_VDB_CACHE_SIZE_MB), 0)) * 1024 * 1024;
+    m_numPrefetchFrames = std::max(TfGetEnvSetting(HDRPR_VDB_PREFETCH_FRAMES), 0);
+    m_prefetchMemoryBudget = size_t(std::max(TfGetEnvSetting(HDRPR_VDB_PREFETCH_SIZE_MB), 0)) * 1024 * 1024;
+}
+
+void VdbGridCache::StopPrefetching() {
+    m_prefetchDispatcher.Cancel();
+    m_prefetchDispatcher.Wait();
+}
+
+std::string VdbGridCache::GetGridKey(std::string const& path, std::string const& gridName, int downsampleFactor) {
+    double modificationTime = 0.0;
+    ArchGetModificationTime(path.c_str(), &modificationTime);
+    auto key = TfStringPrintf("%s\n%s\n%.6f", path.c_str(), gridName.c_str(), modificationTime);
+
+    if (downsampleFactor > 1) {
+        key += TfStringPrintf("\n1/%d", downsampleFactor);
+    }
+    return key;
+}
+
+std::string VdbGridCache::GetFloatGridDataKey(std::string const& gridKey, openvdb::Coord const& coordOffset) {
+    return TfStringPrintf("%s\n%d,%d,%d", gridKey.c_str(), coordOffset.x(), coordOffset.y(), coordOffset.z());
+}
+
+openvdb::GridBase::ConstPtr VdbGridCache::GetGrid(std::string const& path, std::string const& gridName, int downsampleFactor) {
+    auto grid = GetSourceGrid(path, gridName);
+    if (downsampleFactor <= 1 || !grid || grid->type() != openvdb::FloatGrid::gridType()) {
+        return grid;
+    }
+
+    if (IsHoudiniGridPath(path)) {
+        return DownsampleFloatGrid(static_cast<openvdb::FloatGrid const&>(*grid), downsampleFactor);
+    }
+
+    auto key = GetGridKey(path, gridName, downsampleFactor);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto entry = Find(key)) {
+            return entry->grid;
+        }
+    }
+
+    openvdb::GridBase::ConstPtr downsampledGrid = DownsampleFloatGrid(static_cast<openvdb::FloatGrid const&>(*grid), downsampleFactor);
+
+    Entry entry;
+    entry.key = std::move(key);
+    entry.grid = downsampledGrid;
+    entry.size = downsampledGrid->memUsage();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Insert(std::move(entry));
+
+    return downsampledGrid;
+}
+
+openvdb::GridBase::ConstPtr VdbGridCache::GetSourceGrid(std::string const& path, std::string const& gridName) {
+    if (IsHoudiniGridPath(path)) {
+        // Lifetime of the grid managed by Houdini
+        auto grid = HoudiniOpenvdbLoader::Instance().GetGrid(path.c_str(), gridName.c_str());
+        return openvdb::GridBase::ConstPtr(grid, [](openvdb::GridBase const*) {});
+    }
+
+    auto key = GetGridKey(path, gridName, 1);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto entry = Find(key)) {
+            return entry->grid;
+        }
+    }
+
+    openvdb::GridBase::ConstPtr grid;
+    try {
+        openvdb::io::File file(path);
+        file.open();
+        grid = file.readGrid(gridName);
+    } catch (openvdb::Exception const& e) {
+        TF_RUNTIME_ERROR("Failed to read \"%s\" grid from vdb file \"%s\": %s", gridName.c_str(), path.c_str(), e.what());
+        return nullptr;
+    }
+
+    if (grid) {
+        Entry entry;
+        entry.key = std::move(key);
+        entry.grid = grid;
+        entry.size = grid->memUsage();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Insert(std::move(entry));
+    }
+
+    return grid;
+}
+
+size_t VdbGridCache::GetActiveVoxelCount(std::string const& path, std::string const& gridName) {
+    if (!IsHoudiniGridPath(path)) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (auto entry = Find(GetGridKey(path, gridName, 1))) {
+                return size_t(entry->grid->activeVoxelCount());
+            }
+        }
+
+        // Files written by OpenVDB store grid statistics in the grid metadata
+        try {
+            openvdb::io::File file(path);
+            file.open();
+            auto metadata = file.readGridMetadata(gridName);
+            if (auto voxelCount = metadata->getMetadata<openvdb::Int64Metadata>(openvdb::GridBase::META_FILE_VOXEL_COUNT)) {
+                return size_t(std::max(voxelCount->value(), openvdb::Int64(0)));
+            }
+        } catch (openvdb::Exception const&) {
+            // Fall back to the loaded grid, its loading reports the error
+        }
+    }
+
+    auto grid = GetSourceGrid(path, gridName);
+    return grid ? size_t(grid->activeVoxelCount()) : 0;
+}
+
+std::shared_ptr<VdbGridCache::FloatGridData const> VdbGridCache::GetFloatGridData(std::string const& path, std::string const& gridName, openvdb::Coord const& coordOffset, int downsampleFactor) {
+    auto grid = GetGrid(path, gridName, downsampleFactor);
+    if (!grid || grid->type() != openvdb::FloatGrid::gridType()) {
+        return nullptr;
+    }
+
+    if (IsHoudiniGridPath(path)) {
+        auto data = std::make_shared<FloatGridData>();
+        ReadFloatGrid(static_cast<openvdb::FloatGrid const*>(grid.get()), coordOffset, data.get());
+        return data;
+    }
+
+    auto gridKey = GetGridKey(path, gridName, downsampleFactor);
+    auto key = GetFloatGridDataKey(gridKey, coordOffset);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (auto entry = Find(key)) {
+            return entry->floatGridData;
+        }
+    }
+
+    auto data = std::make_shared<FloatGridData>();
+    ReadFloatGrid(static_cast<openvdb::FloatGrid const*>(grid.get()), coordOffset, data.get());
+
+    Entry entry;
+    entry.key = std::move(key);
+    entry.floatGridData = data;
+    entry.size = data->GetMemoryUsage();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Insert(std::move(entry));
+
+    return data;
+}
+
+void VdbGridCache::PrefetchSequence(std::vector<PrefetchGrid> const& grids, int downsampleFactor) {
+    if (!m_numPrefetchFrames || grids.empty()) {
+        return;
+    }
+
+    // Frames are prefetched only while all grids have them
+    std::vector<std::vector<PrefetchGrid>> frames(m_numPrefetchFrames);
+    for (auto& grid : grids) {
+        if (IsHoudiniGridPath(grid.path)) {
+            return;
+        }
+
+        auto framePaths = GetNextSequenceFramePaths(grid.path, m_numPrefetchFrames);
+        frames.resize(std::min(frames.size(), framePaths.size()));
+        for (size_t i = 0; i < frames.size(); ++i) {
+            frames[i].push_back({std::move(framePaths[i]), grid.gridName});
+        }
+    }
+
+    for (auto& frameGrids : frames) {
+        std::string frameKey;
+        for (auto& grid : frameGrids) {
+            frameKey += grid.path + "\n" + grid.gridName + "\n";
+        }
+        frameKey += std::to_string(downsampleFactor);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_pendingPrefetches.insert(frameKey).second) {
+                continue;
+            }
+        }
+
+        m_prefetchDispatcher.Run([this, frameGrids, downsampleFactor, frameKey]() {
+            Prefetch(frameGrids, downsampleFactor);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pendingPrefetches.erase(frameKey);
+        });
+    }
+}
+
+bool VdbGridCache::IsPrefetchAllowed() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_memoryUsage < std::min(m_prefetchMemoryBudget, m_memoryBudget);
+}
+
+void VdbGridCache::Prefetch(std::vector<PrefetchGrid> const& frameGrids, int downsampleFactor) {
+    std::vector<openvdb::GridBase::ConstPtr> floatGrids;
+    openvdb::CoordBBox activeBBox;
+    for (auto& grid : frameGrids) {
+        if (!IsPrefetchAllowed()) {
+            return;
+        }
+
+        auto floatGrid = GetGrid(grid.path, grid.gridName, downsampleFactor);
+        if (floatGrid && floatGrid->type() == openvdb::FloatGrid::gridType()) {
+            activeBBox.expand(floatGrid->evalActiveVoxelBoundingBox());
+            floatGrids.push_back(std::move(floatGrid));
+        } else {
+            floatGrids.push_back(nullptr);
+        }
+    }
+
+    // The volume offsets voxels by the minimum of the union of active bounding boxes of its grids
+    auto coordOffset = -activeBBox.min();
+    for (size_t i = 0; i < frameGrids.size(); ++i) {
+        if (!floatGrids[i] || !IsPrefetchAllowed()) {
+            continue;
+        }
+        GetFloatGridData(frameGrids[i].path, frameGrids[i].gridName, coordOffset, downsampleFactor);
+    }
+}
+
+void VdbGridCache::SetMemoryBudget(size_t numBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memoryBudget = numBytes;
+    EvictIfNeeded();
+}
+
+size_t VdbGridCache::GetMemoryUsage() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_memoryUsage;
+}
+
+VdbGridCache::Entry const* VdbGridCache::Find(std::string const& key) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return nullptr;
+    }
+
+    // Move to the front of LRU list
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return &(*it->second);
+}
+
+void VdbGridCache::Insert(Entry&& entry) {
+    auto it = m_entries.find(entry.key);
+    if (it != m_entries.end()) {
+        // Entry might be inserted concurrently, replace it with the latest one
+        m_memoryUsage -= it->second->size;
+        m_lru.erase(it->second);
+        m_entries.erase(it);
+    }
+
+    m_memoryUsage += entry.size;
+    m_lru.push_front(std::move(entry));
+    m_entries.emplace(m_lru.front().key, m_lru.begin());
+
+    EvictIfNeeded();
+}
+
+void VdbGridCache::EvictIfNeeded() {
+    // Evicted data stays alive while it's referenced by volumes
+    while (m_memoryUsage > m_memoryBudget && !m_lru.empty()) {
+        auto& entry = m_lru.back();
+        m_memoryUsage -= entry.size;
+        m_entries.erase(entry.key);
+        m_lru.pop_back();
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
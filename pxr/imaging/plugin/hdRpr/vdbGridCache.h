@@ -0,0 +1,123 @@
+/************************************************************************
+Copyright 2020 Advanced Micro Devices, Inc
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+    http://www.apache.org/licenses/LICENSE-2.0
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+************************************************************************/
+
+#ifndef HDRPR_VDB_GRID_CACHE_H
+#define HDRPR_VDB_GRID_CACHE_H
+
+#include "pxr/pxr.h"
+#include "pxr/base/vt/types.h"
+#include "pxr/base/work/dispatcher.h"
+
+#include <openvdb/openvdb.h>
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Whether path refers to a grid of Houdini SOP ("op:" prefix) rather than to .vdb file
+bool IsHoudiniGridPath(std::string const& path);
+
+/// Process-wide cache of OpenVDB grids and of the RPR-ready data extracted from them.
+/// Shared between all volume prims of all render delegates so that a .vdb file
+/// referenced by several fields or volumes is parsed only once.
+/// Houdini SOP grids are not cached: Houdini does not expose anything that tells whether
+/// the grid was recooked, so the data derived from them is computed on each request.
+class VdbGridCache {
+public:
+    static VdbGridCache& GetInstance();
+
+    struct FloatGridData {
+        /// xyz triplets of active voxel coordinates, offsetted by coordOffset.
+        /// Can be shared with RPR volume channels without copying
+        VtUIntArray indices;
+        /// Source values of active voxels
+        VtFloatArray values;
+        float minValue = 0.0f;
+        float maxValue = 0.0f;
+
+        size_t GetMemoryUsage() const;
+    };
+
+    /// Returns grid by path and name. Path can point to .vdb file or to Houdini SOP ("op:" prefix).
+    /// Float grids are resampled to downsampleFactor times larger voxels when downsampleFactor is greater than 1
+    openvdb::GridBase::ConstPtr GetGrid(std::string const& path, std::string const& gridName, int downsampleFactor = 1);
+
+    /// Returns active voxels of float grid. Returns nullptr if grid could not be loaded or it's not a float grid
+    std::shared_ptr<FloatGridData const> GetFloatGridData(std::string const& path, std::string const& gridName, openvdb::Coord const& coordOffset, int downsampleFactor = 1);
+
+    /// Returns the number of active voxels of the full resolution grid.
+    /// Read from the file metadata when available so that the grid is not loaded
+    size_t GetActiveVoxelCount(std::string const& path, std::string const& gridName);
+
+    struct PrefetchGrid {
+        std::string path;
+        std::string gridName;
+    };
+    /// Starts loading of the next frames of the grids of a volume on worker threads. Only the given grids are loaded,
+    /// their voxels are extracted with the offset the volume uses: the minimum of the union of their active bounding boxes.
+    /// Frames are detected by the frame number in the file name, e.g. explosion.0012.vdb.
+    /// Does nothing when prefetching is disabled (HDRPR_VDB_PREFETCH_FRAMES is 0)
+    void PrefetchSequence(std::vector<PrefetchGrid> const& grids, int downsampleFactor);
+
+    /// Cancels prefetching and waits for running prefetch tasks. Prefetching can be started again afterwards
+    void StopPrefetching();
+
+    void SetMemoryBudget(size_t numBytes);
+    size_t GetMemoryUsage();
+
+private:
+    VdbGridCache();
+
+    struct Entry {
+        std::string key;
+        openvdb::GridBase::ConstPtr grid;
+        std::shared_ptr<FloatGridData const> floatGridData;
+        size_t size = 0;
+    };
+    using EntryList = std::list<Entry>;
+
+    openvdb::GridBase::ConstPtr GetSourceGrid(std::string const& path, std::string const& gridName);
+
+    std::string GetGridKey(std::string const& path, std::string const& gridName, int downsampleFactor);
+    std::string GetFloatGridDataKey(std::string const& gridKey, openvdb::Coord const& coordOffset);
+
+    void Prefetch(std::vector<PrefetchGrid> const& frameGrids, int downsampleFactor);
+    bool IsPrefetchAllowed();
+
+    Entry const* Find(std::string const& key);
+    void Insert(Entry&& entry);
+    void EvictIfNeeded();
+
+private:
+    std::mutex m_mutex;
+    EntryList m_lru;
+    std::unordered_map<std::string, EntryList::iterator> m_entries;
+
+    size_t m_memoryUsage = 0;
+    size_t m_memoryBudget;
+
+    int m_numPrefetchFrames;
+    size_t m_prefetchMemoryBudget;
+    std::unordered_set<std::string> m_pendingPrefetches;
+    WorkDispatcher m_prefetchDispatcher;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDRPR_VDB_GRID_CACHE_H
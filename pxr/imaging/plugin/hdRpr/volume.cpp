@@ -12,13 +12,15 @@ limitations under the License.
 ************************************************************************/
 
 #include "volume.h"
+#include "field.h"
 #include "rprApi.h"
 #include "renderParam.h"
+#include "config.h"
 
-#include "houdini/openvdb.h"
+#include "vdbGridCache.h"
 
-#include "pxr/usd/ar/resolver.h"
-#include "pxr/usd/sdf/assetPath.h"
+#include "pxr/base/tf/envSetting.h"
+#include "pxr/base/work/loops.h"
 #include "pxr/usd/usdLux/blackbody.h"
 
 #include <openvdb/openvdb.h>
@@ -27,14 +29,14 @@ limitations under the License.
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+TF_DEFINE_ENV_SETTING(HDRPR_VOLUME_MAX_VOXELS, 0,
+    "Maximum number of active voxels per volume grid, larger grids are downsampled. 0 means no limit");
+
 TF_DEFINE_PRIVATE_TOKENS(
     HdRprVolumeTokens,
-    (filePath) \
     (density) \
     (color) \
     (points) \
-    (temperatureOffset) \
-    (temperatureScale) \
     (emissive)
 );
 
@@ -52,37 +54,79 @@ const float defaultDensity = 100.f;      // RPR take density value of 100 as ful
 GfVec3f defaultColor = GfVec3f(0.0f);    // Default color of black
 GfVec3f defaultEmission = GfVec3f(0.0f); // Default to no emission
 
-} // namespace anonymous
-
-void ReadFloatGrid(openvdb::FloatGrid const* grid, const openvdb::Coord& coordOffset, float valueOffset, float valueScale, std::vector<uint32_t>& outDensityGridOnIndices, std::vector<float>& outDensityGridOnValueIndices) {
-    for (auto iter = grid->beginValueOn(); iter; ++iter) {
-        openvdb::Coord curCoord = iter.getCoord() + coordOffset;
-        outDensityGridOnIndices.push_back(curCoord.x());
-        outDensityGridOnIndices.push_back(curCoord.y());
-        outDensityGridOnIndices.push_back(curCoord.z());
+/// Returns integer factor by which grids should be downsampled.
+/// Interactive render qualities trade volume resolution for load time and memory
+int GetDownsampleFactor(int renderQuality, size_t numActiveVoxels) {
+    int downsampleFactor = 1;
+    if (renderQuality == kRenderQualityLow) {
+        downsampleFactor = 4;
+    } else if (renderQuality == kRenderQualityMedium) {
+        downsampleFactor = 2;
+    }
 
-        float value = (float)(grid->getAccessor().getValue(iter.getCoord()));
-        outDensityGridOnValueIndices.push_back((value + valueOffset) * valueScale);
+    static const size_t maxVoxels = size_t(std::max(TfGetEnvSetting(HDRPR_VOLUME_MAX_VOXELS), 0));
+    if (maxVoxels) {
+        // Each downsample step reduces the number of voxels by factor^3
+        while (numActiveVoxels / size_t(downsampleFactor * downsampleFactor * downsampleFactor) > maxVoxels) {
+            ++downsampleFactor;
+        }
     }
+
+    return downsampleFactor;
 }
 
-struct GridData {
-    std::vector<float> values;
-    std::vector<float> valueLUT;
-    std::vector<uint32_t> indices;
+} // namespace anonymous
 
-    void DuplicateWithUniformValue(GridData& target, float valueChannel0, float valueChannel1, float valueChannel2) const {
-        target.indices = indices;
+/// Copies values applying (value + offset) * scale to each of them
+void RemapGridValues(VtFloatArray const& srcValues, float valueOffset, float valueScale, VtFloatArray* dstValues) {
+    dstValues->resize(srcValues.size());
+    auto src = srcValues.cdata();
+    auto dst = dstValues->data();
+    WorkParallelForN(srcValues.size(), [src, dst, valueOffset, valueScale](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            dst[i] = (src[i] + valueOffset) * valueScale;
+        }
+    });
+}
 
-        //color grid has one uniform color
-        target.valueLUT.clear();
-        target.valueLUT.push_back(valueChannel0);
-        target.valueLUT.push_back(valueChannel1);
-        target.valueLUT.push_back(valueChannel2);
+VtFloatArray const& GetBlackbodyLookup() {
+    static VtFloatArray lookup = []() {
+        VtFloatArray lookup;
+        for (int i = 0; i <= 12000; i += 100) {
+            GfVec3f color = UsdLuxBlackbodyTemperatureAsRgb((float)i);
+            if (i <= 1000) {
+                color *= (float)i / 1000.0f;
+                color *= (float)i / 1000.0f;
+            }
+            lookup.push_back(color.data()[0]);
+            lookup.push_back(color.data()[1]);
+            lookup.push_back(color.data()[2]);
+        }
+        return lookup;
+    }();
+    return lookup;
+}
 
-        target.values.resize(values.size(), 0);
-    }
-};
+/// Channel with the same value in each voxel, RPR volume reuses the grid of other channel for it
+HdRprApiVolumeChannel CreateConstantChannel(GfVec3f const& value) {
+    HdRprApiVolumeChannel channel;
+    channel.lookup = VtFloatArray{value[0], value[1], value[2]};
+    return channel;
+}
+
+bool HdRprVolume::FieldChannel::IsValid(HdRprField const* field, GfVec3i const& coordOffset, int downsampleFactor) const {
+    return fieldId == field->GetId() &&
+        fieldVersion == field->GetVersion() &&
+        this->coordOffset == coordOffset &&
+        this->downsampleFactor == downsampleFactor;
+}
+
+void HdRprVolume::FieldChannel::SetSource(HdRprField const* field, GfVec3i const& coordOffset, int downsampleFactor) {
+    fieldId = field->GetId();
+    fieldVersion = field->GetVersion();
+    this->coordOffset = coordOffset;
+    this->downsampleFactor = downsampleFactor;
+}
 
 HdRprVolume::HdRprVolume(SdfPath const& id)
     : HdVolume(id) {
@@ -100,198 +144,195 @@ void HdRprVolume::Sync(
 
     auto& id = GetId();
 
+    bool updateTransform = false;
     if (*dirtyBits & HdChangeTracker::DirtyTransform) {
         m_transform = GfMatrix4f(sceneDelegate->GetTransform(id));
+        updateTransform = true;
     }
 
-    if (*dirtyBits & HdChangeTracker::DirtyTopology) {
-        if (m_rprVolume) {
-            rprApi->Release(m_rprVolume);
-        }
-        m_rprVolume = nullptr;
+    rprRenderParam->AddVolume(this);
 
-        openvdb::initialize();
-        std::map<std::string, openvdb::GridBase::Ptr> openvdbFileGrids;
-
-        auto getVdbGrid = [&id, &openvdbFileGrids]
-            (SdfAssetPath const& assetPath, const char* name) -> openvdb::GridBase const* {
-            if (assetPath.GetAssetPath().compare(0, sizeof("op:") - 1, "op:") == 0) {
-                return HoudiniOpenvdbLoader::Instance().GetGrid(assetPath.GetAssetPath().c_str(), name);
-            } else {
-                std::string openvdbPath;
-                if (assetPath.GetResolvedPath().empty()) {
-                    openvdbPath = ArGetResolver().Resolve(assetPath.GetAssetPath());
-                } else {
-                    openvdbPath = assetPath.GetResolvedPath();
-                }
-
-                auto gridId = openvdbPath + name;
-                auto gridIter = openvdbFileGrids.find(gridId);
-                if (gridIter != openvdbFileGrids.end()) {
-                    return gridIter->second.get();
-                }
-
-                try {
-                    openvdb::io::File file(openvdbPath);
-                    file.open();
-                    auto grid = file.readGrid(name);
-                    auto ret = grid.get();
-                    openvdbFileGrids[gridId] = std::move(grid);
-                    return ret;
-                } catch (openvdb::IoError const& e) {
-                    TF_RUNTIME_ERROR("[%s] Failed to open vdb file \"%s\": %s", id.GetName().c_str(), openvdbPath.c_str(), e.what());
-                }
+    if (*dirtyBits & GetFieldDirtyBits()) {
+        m_syncedRenderQuality = rprApi->GetCurrentRenderQuality();
+        if (SyncFields(sceneDelegate, rprApi)) {
+            updateTransform = true;
+        } else {
+            if (m_rprVolume) {
+                rprApi->Release(m_rprVolume);
+                m_rprVolume = nullptr;
             }
+            m_densityChannel = {};
+            m_temperatureChannel = {};
+        }
+    }
 
-            return nullptr;
-        };
-
-        std::map<TfToken, openvdb::GridBase const*> fieldGrids;
-        float temperatureOffset = 0.0f;
-        float temperatureScale = 1.0f;
-
-        auto volumeFieldDescriptorVector = sceneDelegate->GetVolumeFieldDescriptors(GetId());
-        for (auto const& desc : sceneDelegate->GetVolumeFieldDescriptors(GetId())) {
-            auto param = sceneDelegate->Get(desc.fieldId, HdRprVolumeTokens->filePath);
-            if (param.IsHolding<SdfAssetPath>()) {
-                if (desc.fieldName == HdRprVolumeTokens->color) {
-                    // XXX: Currently we only track color field presence
-                    // to know if we need to generate color grid from temperature grid.
-                    // Original minghao implementation.
-                    // More testing assets required.
-                    fieldGrids[desc.fieldName] = nullptr;
-                } else {
-                    fieldGrids[desc.fieldName] = getVdbGrid(param.UncheckedGet<SdfAssetPath>(), desc.fieldName.GetText());
-                }
-            }
+    if (m_rprVolume && updateTransform) {
+        rprApi->SetTransform(m_rprVolume, m_transform);
+    }
 
-            if (desc.fieldName == HdRprVolumeTokens->emissive) {
-                temperatureOffset = sceneDelegate->Get(desc.fieldId, HdRprVolumeTokens->temperatureOffset).GetWithDefault(0.0f);
-                temperatureScale = sceneDelegate->Get(desc.fieldId, HdRprVolumeTokens->temperatureScale).GetWithDefault(1.0f);
-            }
-        }
+    *dirtyBits = HdChangeTracker::Clean;
+}
 
-        if (fieldGrids.empty()) {
-            *dirtyBits = HdChangeTracker::Clean;
-            return;
+bool HdRprVolume::SyncFields(HdSceneDelegate* sceneDelegate, HdRprApi* rprApi) {
+    HdRprField* densityField = nullptr;
+    HdRprField* temperatureField = nullptr;
+    bool hasColor = false;
+    bool hasAnyField = false;
+
+    auto& renderIndex = sceneDelegate->GetRenderIndex();
+    for (auto const& desc : sceneDelegate->GetVolumeFieldDescriptors(GetId())) {
+        auto field = static_cast<HdRprField*>(renderIndex.GetBprim(desc.fieldPrimType, desc.fieldId));
+        if (!field || field->GetFilePath().empty()) {
+            continue;
+        }
+        hasAnyField = true;
+
+        if (desc.fieldName == HdRprVolumeTokens->color) {
+            // XXX: Currently we only track color field presence
+            // to know if we need to generate color grid from temperature grid.
+            // Original minghao implementation.
+            // More testing assets required.
+            hasColor = true;
+        } else if (desc.fieldName == HdRprVolumeTokens->density) {
+            densityField = field;
+        } else if (desc.fieldName == HdRprVolumeTokens->emissive) {
+            temperatureField = field;
         }
+    }
 
-        auto colorGridIter = fieldGrids.find(HdRprVolumeTokens->color);
-        auto densityGridIter = fieldGrids.find(HdRprVolumeTokens->density);
-        auto temperatureGridIter = fieldGrids.find(HdRprVolumeTokens->emissive);
+    if (!hasAnyField) {
+        return false;
+    }
 
-        bool hasColor = colorGridIter != fieldGrids.end();
-        bool hasDensity = densityGridIter != fieldGrids.end();
-        bool hasTemperature = temperatureGridIter != fieldGrids.end();
+    // Downsample factor is chosen from the voxel counts stored in the files so that full resolution grids are not loaded
+    // when only their downsampled versions are rendered
+    size_t numActiveVoxels = 0;
+    if (densityField)
+        numActiveVoxels = std::max(numActiveVoxels, densityField->GetActiveVoxelCount(HdRprVolumeTokens->density.GetString()));
+    if (temperatureField)
+        numActiveVoxels = std::max(numActiveVoxels, temperatureField->GetActiveVoxelCount(HdRprVolumeTokens->emissive.GetString()));
 
-        auto densityGrid = hasDensity ? openvdbGridCast<openvdb::FloatGrid>(densityGridIter->second) : nullptr;
-        auto temperatureGrid = hasTemperature ? openvdbGridCast<openvdb::FloatGrid>(temperatureGridIter->second) : nullptr;
+    int downsampleFactor = GetDownsampleFactor(rprApi->GetCurrentRenderQuality(), numActiveVoxels);
 
-        if (hasDensity && !densityGrid) {
-            TF_RUNTIME_ERROR("[Node: %s]: vdb density grid doesn't have float type.", GetId().GetName().c_str());
-            hasDensity = false;
-        }
+    auto densityGridHolder = densityField ? densityField->GetGrid(HdRprVolumeTokens->density.GetString(), downsampleFactor) : nullptr;
+    auto temperatureGridHolder = temperatureField ? temperatureField->GetGrid(HdRprVolumeTokens->emissive.GetString(), downsampleFactor) : nullptr;
 
-        if (hasTemperature && !temperatureGrid) {
-            TF_RUNTIME_ERROR("[Node: %s]: vdb temperature grid doesn't have float type.", GetId().GetName().c_str());
-            hasTemperature = false;
-        }
+    auto densityGrid = openvdbGridCast<openvdb::FloatGrid>(densityGridHolder.get());
+    auto temperatureGrid = openvdbGridCast<openvdb::FloatGrid>(temperatureGridHolder.get());
 
-        if (!hasDensity && !hasTemperature) {
-            TF_RUNTIME_ERROR("[Node: %s]: does not have the needed grids.", GetId().GetName().c_str());
-            *dirtyBits = HdChangeTracker::Clean;
-            return;
-        }
+    if (densityField && !densityGrid) {
+        TF_RUNTIME_ERROR("[Node: %s]: vdb density grid doesn't have float type.", GetId().GetName().c_str());
+    }
 
-        //If we need to read from both grids, check compatibility
-        if (hasDensity && hasTemperature) {
-            if (densityGrid->voxelSize() != temperatureGrid->voxelSize())
-                TF_RUNTIME_ERROR("[Node: %s]: density grid and temperature grid differs in voxel sizes. Taking voxel size of density grid", GetId().GetName().c_str());
-            if (densityGrid->transform() != temperatureGrid->transform())
-                TF_RUNTIME_ERROR("[Node: %s]: density grid and temperature grid have different transform. Taking transform of density grid", GetId().GetName().c_str());
-        }
+    if (temperatureField && !temperatureGrid) {
+        TF_RUNTIME_ERROR("[Node: %s]: vdb temperature grid doesn't have float type.", GetId().GetName().c_str());
+    }
 
-        openvdb::Vec3d voxelSize = hasDensity ? densityGrid->voxelSize() : temperatureGrid->voxelSize();
-        openvdb::math::Transform gridTransform = hasDensity ? densityGrid->transform() : temperatureGrid->transform();
-        openvdb::CoordBBox gridOnBB;
-        if (hasDensity)
-            gridOnBB.expand(densityGrid->evalActiveVoxelBoundingBox());
-        if (hasTemperature)
-            gridOnBB.expand(temperatureGrid->evalActiveVoxelBoundingBox());
-        openvdb::Coord gridOnBBSize = gridOnBB.extents();
-
-        GridData srcDensityGridData;
-        GridData srcTemperatureGridData;
-        GridData defaultEmissionGridData;
-        GridData defaultColorGridData;
-        GridData defaultDensityGridData;
-
-        GridData* pDensityGridData = nullptr;
-        GridData* pColorGridData = nullptr;
-        GridData* pEmissiveGridData = nullptr;
-
-        if (hasDensity) {
-            float minVal, maxVal;
-            densityGrid->evalMinMax(minVal, maxVal);
-            float valueScale = (maxVal <= minVal) ? 1.0f : (1.0f / (maxVal - minVal));
-            ReadFloatGrid(densityGrid, -gridOnBB.min(), -minVal, valueScale, srcDensityGridData.indices, srcDensityGridData.values);
-            srcDensityGridData.valueLUT.push_back(minVal);
-            srcDensityGridData.valueLUT.push_back(minVal);
-            srcDensityGridData.valueLUT.push_back(minVal);
-            srcDensityGridData.valueLUT.push_back(maxVal);
-            srcDensityGridData.valueLUT.push_back(maxVal);
-            srcDensityGridData.valueLUT.push_back(maxVal);
-
-            pDensityGridData = &srcDensityGridData;
-        }
+    bool hasDensity = densityGrid != nullptr;
+    bool hasTemperature = temperatureGrid != nullptr;
 
-        if (hasTemperature) {
-            ReadFloatGrid(temperatureGrid, -gridOnBB.min(), temperatureOffset, temperatureScale / 12000.0f, srcTemperatureGridData.indices, srcTemperatureGridData.values);
-            for (int i = 0; i <= 12000; i += 100) {
-                GfVec3f color = UsdLuxBlackbodyTemperatureAsRgb((float)i);
-                if (i <= 1000) {
-                    color *= (float)i / 1000.0f;
-                    color *= (float)i / 1000.0f;
-                }
-                srcTemperatureGridData.valueLUT.push_back(color.data()[0]);
-                srcTemperatureGridData.valueLUT.push_back(color.data()[1]);
-                srcTemperatureGridData.valueLUT.push_back(color.data()[2]);
-            }
-            pEmissiveGridData = &srcTemperatureGridData;
+    if (!hasDensity && !hasTemperature) {
+        TF_RUNTIME_ERROR("[Node: %s]: does not have the needed grids.", GetId().GetName().c_str());
+        return false;
+    }
 
-            if (hasColor)
-                pColorGridData = &srcTemperatureGridData;
-        }
+    //If we need to read from both grids, check compatibility
+    if (hasDensity && hasTemperature) {
+        if (densityGrid->voxelSize() != temperatureGrid->voxelSize())
+            TF_RUNTIME_ERROR("[Node: %s]: density grid and temperature grid differs in voxel sizes. Taking voxel size of density grid", GetId().GetName().c_str());
+        if (densityGrid->transform() != temperatureGrid->transform())
+            TF_RUNTIME_ERROR("[Node: %s]: density grid and temperature grid have different transform. Taking transform of density grid", GetId().GetName().c_str());
+    }
 
-        if (!pDensityGridData) {
-            srcTemperatureGridData.DuplicateWithUniformValue(defaultDensityGridData, defaultDensity, defaultDensity, defaultDensity);
-            pDensityGridData = &defaultDensityGridData;
-        }
-        if (!pEmissiveGridData) {
-            srcDensityGridData.DuplicateWithUniformValue(defaultEmissionGridData, defaultEmission.data()[0], defaultEmission.data()[1], defaultEmission.data()[2]);
-            pEmissiveGridData = &defaultEmissionGridData;
+    openvdb::Vec3d voxelSize = hasDensity ? densityGrid->voxelSize() : temperatureGrid->voxelSize();
+    openvdb::math::Transform gridTransform = hasDensity ? densityGrid->transform() : temperatureGrid->transform();
+    openvdb::CoordBBox gridOnBB;
+    if (hasDensity)
+        gridOnBB.expand(densityGrid->evalActiveVoxelBoundingBox());
+    if (hasTemperature)
+        gridOnBB.expand(temperatureGrid->evalActiveVoxelBoundingBox());
+    openvdb::Coord gridOnBBSize = gridOnBB.extents();
+    GfVec3i coordOffset(-gridOnBB.min().x(), -gridOnBB.min().y(), -gridOnBB.min().z());
+
+    auto& gridCache = VdbGridCache::GetInstance();
+
+    // Only channels whose fields, voxel offset or resolution changed are extracted again,
+    // unchanged channels keep their arrays so that RPR reuses their grids
+    if (!hasDensity) {
+        m_densityChannel = {};
+    } else if (!m_densityChannel.IsValid(densityField, coordOffset, downsampleFactor)) {
+        auto densityData = gridCache.GetFloatGridData(densityField->GetFilePath(), HdRprVolumeTokens->density.GetString(), -gridOnBB.min(), downsampleFactor);
+        if (!densityData) {
+            TF_RUNTIME_ERROR("[Node: %s]: failed to read density grid", GetId().GetName().c_str());
+            return false;
         }
-        if (!pColorGridData) {
-            srcDensityGridData.DuplicateWithUniformValue(defaultColorGridData, defaultColor.data()[0], defaultColor.data()[1], defaultColor.data()[2]);
-            pColorGridData = &defaultColorGridData;
+
+        float minVal = densityData->minValue;
+        float maxVal = densityData->maxValue;
+        float valueScale = (maxVal <= minVal) ? 1.0f : (1.0f / (maxVal - minVal));
+
+        auto& channel = m_densityChannel.channel;
+        // Indices are shared with the grid cache, only values are remapped
+        channel.indices = densityData->indices;
+        RemapGridValues(densityData->values, -minVal, valueScale, &channel.values);
+        channel.lookup = VtFloatArray{minVal, minVal, minVal, maxVal, maxVal, maxVal};
+        m_densityChannel.SetSource(densityField, coordOffset, downsampleFactor);
+    }
+
+    if (!hasTemperature) {
+        m_temperatureChannel = {};
+    } else if (!m_temperatureChannel.IsValid(temperatureField, coordOffset, downsampleFactor)) {
+        auto temperatureData = gridCache.GetFloatGridData(temperatureField->GetFilePath(), HdRprVolumeTokens->emissive.GetString(), -gridOnBB.min(), downsampleFactor);
+        if (!temperatureData) {
+            TF_RUNTIME_ERROR("[Node: %s]: failed to read temperature grid", GetId().GetName().c_str());
+            return false;
         }
 
-        openvdb::Vec3d gridMin = gridTransform.indexToWorld(gridOnBB.min());
-        GfVec3f gridBBLow = GfVec3f((float)(gridMin.x() - voxelSize[0] / 2), (float)(gridMin.y() - voxelSize[1] / 2), (float)(gridMin.z() - voxelSize[2] / 2));
+        auto& channel = m_temperatureChannel.channel;
+        channel.indices = temperatureData->indices;
+        RemapGridValues(temperatureData->values, temperatureField->GetTemperatureOffset(), temperatureField->GetTemperatureScale() / 12000.0f, &channel.values);
+        channel.lookup = GetBlackbodyLookup();
+        m_temperatureChannel.SetSource(temperatureField, coordOffset, downsampleFactor);
+    }
 
-        m_rprVolume = rprApi->CreateVolume(
-            pDensityGridData->indices, pDensityGridData->values, pDensityGridData->valueLUT,
-            pColorGridData->indices, pColorGridData->values, pColorGridData->valueLUT,
-            pEmissiveGridData->indices, pEmissiveGridData->values, pEmissiveGridData->valueLUT,
-            GfVec3i(gridOnBBSize.x(), gridOnBBSize.y(), gridOnBBSize.z()), GfVec3f((float)voxelSize[0], (float)voxelSize[1], (float)voxelSize[2]), gridBBLow);
+    // Animated VDB sequences change file paths every frame,
+    // start loading of the grids of the next frames while the current one is rendered
+    std::vector<VdbGridCache::PrefetchGrid> prefetchGrids;
+    if (hasDensity) {
+        prefetchGrids.push_back({densityField->GetFilePath(), HdRprVolumeTokens->density.GetString()});
+    }
+    if (hasTemperature) {
+        prefetchGrids.push_back({temperatureField->GetFilePath(), HdRprVolumeTokens->emissive.GetString()});
     }
+    gridCache.PrefetchSequence(prefetchGrids, downsampleFactor);
 
-    *dirtyBits = HdChangeTracker::Clean;
+    HdRprApiVolumeChannel densityChannel = hasDensity ? m_densityChannel.channel : CreateConstantChannel(GfVec3f(defaultDensity));
+    HdRprApiVolumeChannel emissionChannel = hasTemperature ? m_temperatureChannel.channel : CreateConstantChannel(defaultEmission);
+    // Albedo shares the RPR grid with the emission channel
+    HdRprApiVolumeChannel albedoChannel = (hasTemperature && hasColor) ? m_temperatureChannel.channel : CreateConstantChannel(defaultColor);
+
+    openvdb::Vec3d gridMin = gridTransform.indexToWorld(gridOnBB.min());
+    GfVec3f gridBBLow = GfVec3f((float)(gridMin.x() - voxelSize[0] / 2), (float)(gridMin.y() - voxelSize[1] / 2), (float)(gridMin.z() - voxelSize[2] / 2));
+    GfVec3i gridSize(gridOnBBSize.x(), gridOnBBSize.y(), gridOnBBSize.z());
+    GfVec3f rprVoxelSize((float)voxelSize[0], (float)voxelSize[1], (float)voxelSize[2]);
+
+    if (m_rprVolume && !rprApi->UpdateVolume(m_rprVolume, densityChannel, albedoChannel, emissionChannel, gridSize, rprVoxelSize, gridBBLow)) {
+        rprApi->Release(m_rprVolume);
+        m_rprVolume = nullptr;
+    }
+    if (!m_rprVolume) {
+        m_rprVolume = rprApi->CreateVolume(densityChannel, albedoChannel, emissionChannel, gridSize, rprVoxelSize, gridBBLow);
+    }
+
+    return m_rprVolume != nullptr;
 }
 
 HdDirtyBits HdRprVolume::GetInitialDirtyBitsMask() const {
     int mask = HdChangeTracker::Clean
         | HdChangeTracker::DirtyTopology
+#if PXR_VERSION >= 2002
+        | HdChangeTracker::DirtyVolumeField
+#endif
         | HdChangeTracker::DirtyTransform
         | HdChangeTracker::DirtyVisibility
         | HdChangeTracker::DirtyPrimvar
@@ -313,8 +354,12 @@ void HdRprVolume::_InitRepr(TfToken const& reprName,
 }
 
 void HdRprVolume::Finalize(HdRenderParam* renderParam) {
-    static_cast<HdRprRenderParam*>(renderParam)->AcquireRprApiForEdit()->Release(m_rprVolume);
+    auto rprRenderParam = static_cast<HdRprRenderParam*>(renderParam);
+    rprRenderParam->RemoveVolume(this);
+    rprRenderParam->AcquireRprApiForEdit()->Release(m_rprVolume);
     m_rprVolume = nullptr;
+    m_densityChannel = {};
+    m_temperatureChannel = {};
 
     HdVolume::Finalize(renderParam);
 }
@@ -14,12 +14,15 @@ limitations under the License.
 #ifndef HDRPR_VOLUME_H
 #define HDRPR_VOLUME_H
 
+#include "rprApi.h"
+
 #include "pxr/imaging/hd/volume.h"
 #include "pxr/base/gf/matrix4f.h"
+#include "pxr/base/gf/vec3i.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
 
-struct HdRprApiVolume;
+class HdRprField;
 
 class HdRprVolume : public HdVolume {
 public:
@@ -37,15 +40,44 @@ public:
 
     HdDirtyBits GetInitialDirtyBitsMask() const override;
 
+    /// Dirty bits that make the volume reload its fields
+    static HdDirtyBits GetFieldDirtyBits() {
+        HdDirtyBits fieldDirtyBits = HdChangeTracker::DirtyTopology;
+#if PXR_VERSION >= 2002
+        fieldDirtyBits |= HdChangeTracker::DirtyVolumeField;
+#endif
+        return fieldDirtyBits;
+    }
+    /// Render quality the grid resolution was chosen for
+    int GetSyncedRenderQuality() const { return m_syncedRenderQuality; }
+
 protected:
     HdDirtyBits _PropagateDirtyBits(HdDirtyBits bits) const override;
 
     void _InitRepr(TfToken const& reprName,
                    HdDirtyBits* dirtyBits) override;
 
+private:
+    bool SyncFields(HdSceneDelegate* sceneDelegate, HdRprApi* rprApi);
+
 private:
     HdRprApiVolume* m_rprVolume = nullptr;
     GfMatrix4f m_transform;
+    int m_syncedRenderQuality = -1;
+
+    /// Volume channel extracted from the grid of the field
+    struct FieldChannel {
+        SdfPath fieldId;
+        uint64_t fieldVersion = 0;
+        GfVec3i coordOffset = GfVec3i(0);
+        int downsampleFactor = 0;
+        HdRprApiVolumeChannel channel;
+
+        bool IsValid(HdRprField const* field, GfVec3i const& coordOffset, int downsampleFactor) const;
+        void SetSource(HdRprField const* field, GfVec3i const& coordOffset, int downsampleFactor);
+    };
+    FieldChannel m_densityChannel;
+    FieldChannel m_temperatureChannel;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE